@@ -0,0 +1,18 @@
+QT       += core gui widgets charts concurrent
+
+CONFIG += c++17
+
+# The trace view against the QtCharts plot it replaced. QtCharts is only
+# needed here, the viewer itself does not link it.
+INCLUDEPATH += ..
+
+SOURCES += \
+    ../fa_plot.cpp \
+    ../traceview.cpp \
+    main.cpp
+
+HEADERS += \
+    ../fa_plot.h \
+    ../traceview.h
+
+TARGET = fa-trace-benchmark
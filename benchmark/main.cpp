@@ -0,0 +1,90 @@
+#include "traceview.h"
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QGraphicsScene>
+#include <QPainter>
+#include <QtCharts/QChart>
+#include <QtCharts/QLineSeries>
+#include <QtCharts/QValueAxis>
+
+#include <cmath>
+#include <iostream>
+
+QT_CHARTS_USE_NAMESPACE
+
+//
+// Draws `frames` frames of `points` points per series through QtCharts,
+// as the viewer drove it: the points copied into QPointF buffers,
+// replace() on both series, the axes set and the scene painted.
+//
+static double chartTime(const fa::trace& trace, QSize size, int frames)
+{
+    size_t points = trace.index.size();
+    QGraphicsScene scene;
+    auto chart = new QChart;
+    auto seriesX = new QLineSeries;
+    auto seriesY = new QLineSeries;
+    auto axisX = new QValueAxis;
+    auto axisY = new QValueAxis;
+    chart->addSeries(seriesX);
+    chart->addSeries(seriesY);
+    chart->addAxis(axisX, Qt::AlignBottom);
+    chart->addAxis(axisY, Qt::AlignLeft);
+    for(auto series : {seriesX, seriesY}) {
+        series->attachAxis(axisX);
+        series->attachAxis(axisY);
+    }
+    scene.addItem(chart);
+    chart->resize(size);
+
+    QImage target(size, QImage::Format_RGB32);
+    QVector<QPointF> pointsX(points);
+    QVector<QPointF> pointsY(points);
+    QElapsedTimer timer;
+    timer.start();
+    for(int f = 0; f < frames; f++) {
+        for(size_t i = 0; i < points; i++) {
+            pointsX[i] = QPointF(trace.index[i], trace.x[i] + f * 1e-3);
+            pointsY[i] = QPointF(trace.index[i], trace.y[i] + f * 1e-3);
+        }
+        seriesX->replace(pointsX);
+        seriesY->replace(pointsY);
+        axisX->setRange(0, points * 0.1);
+        axisY->setRange(-1.2, 1.2);
+        QPainter painter(&target);
+        scene.render(&painter);
+    }
+    return timer.nsecsElapsed() / 1e6 / frames;
+}
+
+//
+// fa-trace-benchmark [points]
+// Frame times of the trace plot against QtCharts, 100000 points per series
+// by default.
+//
+int main(int argc, char *argv[])
+{
+    QApplication a(argc, argv);
+    size_t points = argc > 1 ? QString(argv[1]).toULongLong() : 100000;
+    int frames = 50;
+    QSize size(1200, 700);
+
+    fa::trace trace;
+    trace.index.resize(points);
+    trace.x.resize(points);
+    trace.y.resize(points);
+    for(size_t i = 0; i < points; i++) {
+        trace.index[i] = i * 0.1f;
+        trace.x[i] = std::sin(i * 0.01f) + 0.1f * std::sin(i * 1.7f);
+        trace.y[i] = std::cos(i * 0.013f) + 0.1f * std::sin(i * 2.3f);
+    }
+
+    double charts = chartTime(trace, size, frames);
+    double traces = TraceView::frameTime(trace, size, frames);
+
+    std::cout << points << " points per series, " << frames << " frames of " << size.width() << "x" << size.height() << std::endl;
+    std::cout << "QtCharts:   " << charts << " ms per frame" << std::endl;
+    std::cout << "Trace view: " << traces << " ms per frame (" << charts / traces << "x)" << std::endl;
+    return 0;
+}
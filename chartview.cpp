@@ -1,114 +0,0 @@
-/****************************************************************************
-**
-** Copyright (C) 2016 The Qt Company Ltd.
-** Contact: https://www.qt.io/licensing/
-**
-** This file is part of the Qt Charts module of the Qt Toolkit.
-**
-** $QT_BEGIN_LICENSE:GPL$
-** Commercial License Usage
-** Licensees holding valid commercial Qt licenses may use this file in
-** accordance with the commercial license agreement provided with the
-** Software or, alternatively, in accordance with the terms contained in
-** a written agreement between you and The Qt Company. For licensing terms
-** and conditions see https://www.qt.io/terms-conditions. For further
-** information use the contact form at https://www.qt.io/contact-us.
-**
-** GNU General Public License Usage
-** Alternatively, this file may be used under the terms of the GNU
-** General Public License version 3 or (at your option) any later version
-** approved by the KDE Free Qt Foundation. The licenses are as published by
-** the Free Software Foundation and appearing in the file LICENSE.GPL3
-** included in the packaging of this file. Please review the following
-** information to ensure the GNU General Public License requirements will
-** be met: https://www.gnu.org/licenses/gpl-3.0.html.
-**
-** $QT_END_LICENSE$
-**
-****************************************************************************/
-
-#include "chartview.h"
-#include <QtGui/QMouseEvent>
-#include <QCoreApplication>
-#include <iostream>
-
-ChartView::ChartView(QChart *chart, QWidget *parent) :
-    QChartView(chart, parent),
-    m_isTouching(false)
-{
-    m_isRunning = true;
-    m_isMouseOver = false;
-    m_mouseIndex = 0;
-    setRubberBand(QChartView::RectangleRubberBand);
-    setAttribute(Qt::WA_AcceptTouchEvents, true);
-    viewport()->setAttribute(Qt::WA_AcceptTouchEvents, true);
-    viewport()->setMouseTracking(true);
-
-    QCoreApplication::setAttribute(Qt::AA_SynthesizeMouseForUnhandledTouchEvents, true);
-}
-
-bool ChartView::viewportEvent(QEvent *event)
-{
-    return QChartView::viewportEvent(event);
-}
-
-void ChartView::mousePressEvent(QMouseEvent *event)
-{
-    m_isRunning = false;
-    QChartView::mousePressEvent(event);
-}
-
-void ChartView::mouseMoveEvent(QMouseEvent *event)
-{
-    auto e = static_cast<QMouseEvent*>(event);
-    auto xSeries = qobject_cast<QLineSeries*>(chart()->series().at(0));
-    qreal index = chart()->mapToValue(e->pos(), xSeries).x();
-    m_globalPos = e->globalPos();
-    m_pos = e->pos();
-    m_mouseIndex = index;
-    QChartView::mouseMoveEvent(event);
-}
-
-void ChartView::mouseReleaseEvent(QMouseEvent *event)
-{
-    QChartView::mouseReleaseEvent(event);
-}
-
-//![1]
-void ChartView::keyPressEvent(QKeyEvent *event)
-{
-    switch (event->key()) {
-    case Qt::Key_Plus:
-        chart()->zoomIn();
-        break;
-    case Qt::Key_Minus:
-        chart()->zoomOut();
-        break;
-//![1]
-    case Qt::Key_Left:
-        chart()->scroll(-10, 0);
-        break;
-    case Qt::Key_Right:
-        chart()->scroll(10, 0);
-        break;
-    case Qt::Key_Up:
-        chart()->scroll(0, 10);
-        break;
-    case Qt::Key_Down:
-        chart()->scroll(0, -10);
-        break;
-    default:
-        QGraphicsView::keyPressEvent(event);
-        break;
-    }
-}
-
-bool ChartView::eventFilter(QObject *object, QEvent *e)
-{
-    if (e->type() == QEvent::HoverLeave)
-        m_isMouseOver = false;
-    if (e->type() == QEvent::HoverEnter || e->type() == QEvent::HoverMove)
-        m_isMouseOver = true;
-
-    return QChartView::eventFilter(object, e);
-}
@@ -1,68 +0,0 @@
-/****************************************************************************
-**
-** Copyright (C) 2016 The Qt Company Ltd.
-** Contact: https://www.qt.io/licensing/
-**
-** This file is part of the Qt Charts module of the Qt Toolkit.
-**
-** $QT_BEGIN_LICENSE:GPL$
-** Commercial License Usage
-** Licensees holding valid commercial Qt licenses may use this file in
-** accordance with the commercial license agreement provided with the
-** Software or, alternatively, in accordance with the terms contained in
-** a written agreement between you and The Qt Company. For licensing terms
-** and conditions see https://www.qt.io/terms-conditions. For further
-** information use the contact form at https://www.qt.io/contact-us.
-**
-** GNU General Public License Usage
-** Alternatively, this file may be used under the terms of the GNU
-** General Public License version 3 or (at your option) any later version
-** approved by the KDE Free Qt Foundation. The licenses are as published by
-** the Free Software Foundation and appearing in the file LICENSE.GPL3
-** included in the packaging of this file. Please review the following
-** information to ensure the GNU General Public License requirements will
-** be met: https://www.gnu.org/licenses/gpl-3.0.html.
-**
-** $QT_END_LICENSE$
-**
-****************************************************************************/
-
-#ifndef CHARTVIEW_H
-#define CHARTVIEW_H
-
-#include <QtCharts/QChartView>
-#include <QtWidgets/QRubberBand>
-#include <QToolTip>
-#include <QTouchEvent>
-#include <QLineSeries>
-
-QT_CHARTS_USE_NAMESPACE
-
-//![1]
-class ChartView : public QChartView
-//![1]
-{
-public:
-    ChartView(QChart *chart, QWidget *parent = 0);
-
-    bool m_isRunning;
-    bool m_isMouseOver;
-    QPoint m_globalPos;
-    QPoint m_pos;
-    qreal m_mouseIndex;
-
-//![2]
-protected:
-    bool viewportEvent(QEvent *event);
-    void mousePressEvent(QMouseEvent *event);
-    void mouseMoveEvent(QMouseEvent *event);
-    void mouseReleaseEvent(QMouseEvent *event);
-    void keyPressEvent(QKeyEvent *event);
-    bool eventFilter(QObject* object, QEvent* e);
-//![2]
-
-private:
-    bool m_isTouching;
-};
-
-#endif
@@ -1,4 +1,4 @@
-QT       += core gui uitools charts network concurrent
+QT       += core gui uitools network concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -10,22 +10,61 @@ CONFIG += c++17
 # deprecated API in order to know how to port your code away from it.
 DEFINES += QT_DEPRECATED_WARNINGS
 
+# qmake CONFIG+=count_allocations aborts on a settled refresh tick that allocates.
+count_allocations: DEFINES += FA_COUNT_ALLOCATIONS
+
 # You can also make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
-    chart.cpp \
-    chartview.cpp \
+    fa_acquisition.cpp \
+    fa_analysis.cpp \
+    fa_bus.cpp \
+    fa_cross.cpp \
+    fa_daemon.cpp \
+    fa_decimator.cpp \
+    fa_heatmap.cpp \
+    fa_history.cpp \
+    fa_lines.cpp \
+    fa_monitor.cpp \
+    fa_orbit.cpp \
+    fa_plot.cpp \
+    fa_snapshot.cpp \
+    fa_stats.cpp \
+    fa_trigger.cpp \
+    fa_waterfall.cpp \
+    gridview.cpp \
+    heatmapview.cpp \
     main.cpp \
-    main_window.cpp
+    main_window.cpp \
+    traceview.cpp \
+    waterfallview.cpp
 
 HEADERS += \
-    chart.h \
-    chartview.h \
+    fa_acquisition.h \
+    fa_analysis.h \
+    fa_bus.h \
+    fa_cross.h \
+    fa_daemon.h \
+    fa_decimator.h \
+    fa_heatmap.h \
+    fa_history.h \
+    fa_lines.h \
+    fa_monitor.h \
+    fa_orbit.h \
+    fa_plot.h \
+    fa_snapshot.h \
+    fa_stats.h \
     fa_tools.h \
-    main_window.h
+    fa_trigger.h \
+    fa_waterfall.h \
+    gridview.h \
+    heatmapview.h \
+    main_window.h \
+    traceview.h \
+    waterfallview.h
 
 FORMS += \
     main_window.ui
@@ -42,4 +81,4 @@ RESOURCES += \
 DISTFILES += \
     fa-config.json
 
-LIBS += -lopencv_core
+LIBS += -lopencv_core -lrt
@@ -0,0 +1,628 @@
+#include "fa_acquisition.h"
+#include "fa_history.h"
+#include "fa_tools.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <poll.h>
+
+#define FA_CMD_CF       "CF\n"
+#define FA_CMD_CL       "CL\n"
+#define DEFAULT_PORT    8888
+
+FaAcquisition::FaAcquisition(const QJsonObject& config, bool shared, bool replace, QObject *parent)
+    : QObject(parent),
+      changed(false),
+      forced(false),
+      epfd(-1),
+      wakefd(-1),
+      running(false),
+      pending(0)
+{
+    QJsonArray list = config.value("servers").toArray();
+
+    // Without a "servers" list the top level describes the only archiver.
+    if(list.isEmpty())
+        list.append(config);
+
+    for(auto item : list) {
+        QJsonObject object = item.toObject();
+        server s{};
+
+        s.host     = object.value("ip_address").toString();
+        s.port     = object.value("port").toInt(DEFAULT_PORT);
+        s.firstID  = object.value("first_id").toInt(config.value("first_id").toInt());
+        s.ids      = object.value("ids").toInt(config.value("ids").toInt());
+        s.frequency = -1;
+        s.sock     = -1;
+        s.state    = Idle;
+        s.backoff  = FA_RETRY_MIN;
+        this->servers.push_back(s);
+
+        for(int id = s.firstID; id < s.firstID + s.ids; id++) {
+            std::string name = shared ? fa::bus::name(s.host.toStdString(), s.port, id) : "";
+            std::unique_ptr<fa::bus> bus(new fa::bus);
+            if(bus->create(name, id, s.frequency, replace))
+                this->buses[id] = std::move(bus);
+            else if(errno == EEXIST)
+                this->occupied.push_back(QString::fromStdString(name));
+        }
+    }
+
+    this->pool.setMaxThreadCount(1);
+}
+
+FaAcquisition::~FaAcquisition()
+{
+    stop();
+}
+
+void FaAcquisition::start()
+{
+    struct epoll_event event;
+
+    if(this->running)
+        return;
+
+    this->epfd = epoll_create1(0);
+    this->wakefd = eventfd(0, EFD_NONBLOCK);
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    epoll_ctl(this->epfd, EPOLL_CTL_ADD, this->wakefd, &event);
+
+    // Name lookups of all servers start together, ahead of their first connection.
+    for(server& s : this->servers)
+        s.lookup = QtConcurrent::run(&FaAcquisition::lookup, s.host);
+
+    this->running = true;
+    this->worker = QtConcurrent::run(&this->pool, [this]() { run(); });
+}
+
+void FaAcquisition::stop()
+{
+    uint64_t one = 1;
+
+    if(!this->running)
+        return;
+
+    this->running = false;
+    ssize_t written = ::write(this->wakefd, &one, sizeof(one));
+    Q_UNUSED(written);
+    this->worker.waitForFinished();
+
+    for(server& s : this->servers)
+        close(s, false);
+
+    ::close(this->wakefd);
+    ::close(this->epfd);
+}
+
+void FaAcquisition::subscribe(const QList<int>& ids)
+{
+    uint64_t one = 1;
+
+    QMutexLocker lock(&this->mutex);
+    this->wanted.clear();
+    for(int id : ids)
+        this->wanted.insert(id);
+    this->changed = true;
+    if(this->running) {
+        ssize_t written = ::write(this->wakefd, &one, sizeof(one));
+        Q_UNUSED(written);
+    }
+}
+
+void FaAcquisition::reconnect()
+{
+    uint64_t one = 1;
+
+    QMutexLocker lock(&this->mutex);
+    this->forced = true;
+    if(this->running) {
+        ssize_t written = ::write(this->wakefd, &one, sizeof(one));
+        Q_UNUSED(written);
+    }
+}
+
+QList<int> FaAcquisition::configuredIDs() const
+{
+    QList<int> ids;
+    for(auto& item : this->buses)
+        ids.push_back(item.first);
+    return ids;
+}
+
+std::string FaAcquisition::sharedName(int id)
+{
+    server* s = find(id);
+    return s ? fa::bus::name(s->host.toStdString(), s->port, id) : "";
+}
+
+fa::bus* FaAcquisition::bus(int id)
+{
+    auto item = this->buses.find(id);
+    return item == this->buses.end() ? nullptr : item->second.get();
+}
+
+float FaAcquisition::frequency(int id)
+{
+    fa::bus* bus = this->bus(id);
+    return bus ? bus->frequency() : -1;
+}
+
+int64_t FaAcquisition::alignedTime(const QList<int>& ids)
+{
+    int64_t time = std::numeric_limits<int64_t>::max();
+
+    for(int id : ids) {
+        fa::bus* bus = this->bus(id);
+        if(bus && bus->frequency() > 0)
+            time = std::min(time, bus->time_at(bus->sequence()));
+    }
+
+    return time;
+}
+
+FaAcquisition::server* FaAcquisition::find(int id)
+{
+    for(server& s : this->servers) {
+        if(id >= s.firstID && id < s.firstID + s.ids)
+            return &s;
+    }
+    return nullptr;
+}
+
+QString FaAcquisition::maskString(const std::vector<int>& ids)
+{
+    QStringList ranges;
+
+    for(size_t i = 0; i < ids.size(); i++) {
+        size_t j = i;
+        while(j + 1 < ids.size() && ids[j + 1] == ids[j] + 1)
+            j++;
+        ranges << (i == j ? QString::number(ids[i]) : QString::number(ids[i]) + "-" + QString::number(ids[j]));
+        i = j;
+    }
+
+    return ranges.join(',');
+}
+
+//
+// Addresses are looked up once per host and shared by the CL queries and
+// the stream connections. Lookups run on the thread pool, never on the
+// epoll loop.
+//
+static QMutex resolverMutex;
+static QHash<QString, in_addr> resolverCache;
+
+bool FaAcquisition::lookup(QString host)
+{
+    struct addrinfo hints;
+    struct addrinfo *info;
+
+    {
+        QMutexLocker lock(&resolverMutex);
+        if(resolverCache.contains(host))
+            return true;
+    }
+
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(host.toStdString().c_str(), nullptr, &hints, &info) != 0)
+        return false;
+
+    QMutexLocker lock(&resolverMutex);
+    resolverCache.insert(host, ((struct sockaddr_in*) info->ai_addr)->sin_addr);
+    freeaddrinfo(info);
+    return true;
+}
+
+bool FaAcquisition::cached(QString host, int port, sockaddr_in& address)
+{
+    QMutexLocker lock(&resolverMutex);
+    if(!resolverCache.contains(host))
+        return false;
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr = resolverCache.value(host);
+    return true;
+}
+
+QString FaAcquisition::cachePath(const server& s)
+{
+    QString directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    return directory + "/bpms-" + s.host + "-" + QString::number(s.port) + ".txt";
+}
+
+QStringList FaAcquisition::readCache(const server& s)
+{
+    QFile file(cachePath(s));
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return {};
+    return QString(file.readAll()).split('\n', QString::SkipEmptyParts);
+}
+
+void FaAcquisition::writeCache(const server& s, const QStringList& names)
+{
+    QDir().mkpath(QFileInfo(cachePath(s)).path());
+
+    QSaveFile file(cachePath(s));
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return;
+    file.write(names.join('\n').toUtf8());
+    file.commit();
+}
+
+QStringList FaAcquisition::queryBPMs(QString host, int port)
+{
+    QStringList names;
+    fa::line_parser parser;
+    char buffer[4096];
+    ssize_t bytes;
+    struct pollfd fds[1];
+    sockaddr_in address;
+    auto line = [&names](const char* data, size_t size) {
+        const char* name = static_cast<const char*>(memrchr(data, ' ', size));
+        name = name ? name + 1 : data;
+        if(size > 0)
+            names.push_back(QString::fromLatin1(name, int(data + size - name)));
+    };
+
+    if(!lookup(host) || !cached(host, port, address))
+        return names;
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if(::connect(sock, (struct sockaddr*) &address, sizeof(address)) != 0) {
+        ::close(sock);
+        return names;
+    }
+
+    //
+    // The server closes the connection after the last line; anything that
+    // long is split over as many reads as it takes. A failed request is no
+    // answer at all, so the caller falls back on the cached list.
+    //
+    if(::write(sock, FA_CMD_CL, strlen(FA_CMD_CL)) != ssize_t(strlen(FA_CMD_CL))) {
+        ::close(sock);
+        return names;
+    }
+    fds[0].fd = sock;
+    fds[0].events = POLLIN;
+    while(true) {
+        fds[0].revents = 0;
+        if(::poll(fds, 1, 1000) <= 0)
+            break;
+        bytes = ::read(sock, buffer, sizeof(buffer));
+        if(bytes <= 0)
+            break;
+        parser.feed(buffer, bytes, line);
+    }
+    parser.finish(line);
+
+    ::close(sock);
+    return names;
+}
+
+QStringList FaAcquisition::cachedBPMs()
+{
+    QStringList names;
+
+    // A partial list would number the BPMs wrongly, all servers or nothing.
+    for(const server& s : this->servers) {
+        QStringList list = readCache(s);
+        if(list.isEmpty())
+            return {};
+        names += list;
+    }
+
+    this->listed = names;
+    return names;
+}
+
+void FaAcquisition::refreshBPMs()
+{
+    this->lists.clear();
+    this->pending = this->servers.size();
+
+    //
+    // Every server is queried at once; bpmListChanged() is emitted when the
+    // last one has answered and the result differs from the cached lists.
+    //
+    for(size_t i = 0; i < this->servers.size(); i++) {
+        auto watcher = new QFutureWatcher<QStringList>(this);
+        QString host = this->servers[i].host;
+        int port = this->servers[i].port;
+
+        QObject::connect(watcher, &QFutureWatcher<QStringList>::finished, this, [this, watcher, i]() {
+            QStringList list = watcher->result();
+            const server& s = this->servers[i];
+
+            if(list.isEmpty())
+                list = readCache(s);
+            else
+                writeCache(s, list);
+            this->lists[i] = list;
+            watcher->deleteLater();
+
+            if(--this->pending > 0)
+                return;
+
+            QStringList names;
+            for(size_t k = 0; k < this->servers.size(); k++)
+                names += this->lists[k];
+            if(names != this->listed) {
+                this->listed = names;
+                emit bpmListChanged(names);
+            }
+        });
+        watcher->setFuture(QtConcurrent::run(&FaAcquisition::queryBPMs, host, port));
+    }
+}
+
+void FaAcquisition::run()
+{
+    struct epoll_event events[16];
+    uint64_t value;
+    int count;
+
+    while(this->running) {
+        update();
+
+        count = epoll_wait(this->epfd, events, 16, FA_EPOLL_PERIOD);
+        for(int i = 0; i < count; i++) {
+            if(events[i].data.ptr == nullptr) {
+                // Only clears the counter, the wake-up itself is the message.
+                ssize_t bytes = ::read(this->wakefd, &value, sizeof(value));
+                Q_UNUSED(bytes);
+                continue;
+            }
+
+            server& s = *(server*) events[i].data.ptr;
+            if(s.sock < 0)
+                continue;
+            if(s.connecting)
+                writable(s);
+            else if(events[i].events & EPOLLIN)
+                readable(s);
+            else if(events[i].events & (EPOLLERR | EPOLLHUP))
+                close(s, true);
+        }
+
+        int64_t now = fa::wall_time();
+        for(server& s : this->servers) {
+            if(s.sock < 0 && !s.mask.empty() && now >= s.retry)
+                open(s);
+            else if(s.sock >= 0 && s.state != Streaming && now > s.deadline)
+                close(s, true);
+        }
+    }
+}
+
+void FaAcquisition::update()
+{
+    QSet<int> ids;
+    bool force;
+
+    {
+        QMutexLocker lock(&this->mutex);
+        if(!this->changed && !this->forced)
+            return;
+        ids = this->wanted;
+        force = this->forced;
+        this->changed = false;
+        this->forced = false;
+    }
+
+    for(server& s : this->servers) {
+        std::vector<int> mask;
+        for(int id = s.firstID; id < s.firstID + s.ids; id++) {
+            if(ids.contains(id))
+                mask.push_back(id);
+        }
+
+        if(mask != s.mask || force) {
+            s.mask = mask;
+            close(s, false);
+            s.backoff = FA_RETRY_MIN;
+        }
+    }
+}
+
+void FaAcquisition::open(server& s)
+{
+    struct epoll_event event;
+    int64_t now = fa::wall_time();
+
+    if(!cached(s.host, s.port, s.address)) {
+        if(s.lookup.isRunning()) {
+            s.retry = now + FA_RESOLVE_POLL;
+        }
+        else {
+            s.lookup = QtConcurrent::run(&FaAcquisition::lookup, s.host);
+            s.retry = now + s.backoff;
+            s.backoff = std::min(2 * s.backoff, FA_RETRY_MAX);
+        }
+        return;
+    }
+
+    s.sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    s.state = s.frequency > 0 ? Subscribing : Querying;
+    s.connecting = true;
+    s.partial.clear();
+    s.deadline = now + FA_CONNECT_TIMEOUT;
+
+    if(::connect(s.sock, (struct sockaddr*) &s.address, sizeof(s.address)) < 0 && errno != EINPROGRESS) {
+        close(s, true);
+        return;
+    }
+
+    event.events = EPOLLIN | EPOLLOUT;
+    event.data.ptr = &s;
+    epoll_ctl(this->epfd, EPOLL_CTL_ADD, s.sock, &event);
+}
+
+void FaAcquisition::close(server& s, bool retry)
+{
+    if(s.sock >= 0) {
+        epoll_ctl(this->epfd, EPOLL_CTL_DEL, s.sock, nullptr);
+        ::close(s.sock);
+        s.sock = -1;
+    }
+
+    if(s.state == Streaming)
+        emit connectionChanged(s.host, false);
+
+    s.state = Idle;
+    s.connecting = false;
+    s.partial.clear();
+
+    if(retry) {
+        s.retry = fa::wall_time() + s.backoff;
+        s.backoff = std::min(2 * s.backoff, FA_RETRY_MAX);
+    }
+    else {
+        s.retry = 0;
+    }
+}
+
+void FaAcquisition::writable(server& s)
+{
+    int error = 0;
+    socklen_t length = sizeof(error);
+    struct epoll_event event;
+    QString command;
+
+    if(getsockopt(s.sock, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+        close(s, true);
+        return;
+    }
+
+    s.connecting = false;
+    command = s.state == Querying ? QString(FA_CMD_CF) : "S" + maskString(s.mask) + "\n";
+    if(::write(s.sock, command.toStdString().c_str(), command.length()) != command.length()) {
+        close(s, true);
+        return;
+    }
+
+    event.events = EPOLLIN;
+    event.data.ptr = &s;
+    epoll_ctl(this->epfd, EPOLL_CTL_MOD, s.sock, &event);
+}
+
+void FaAcquisition::readable(server& s)
+{
+    char data[4096];
+    ssize_t bytes;
+
+    bytes = ::recv(s.sock, data, sizeof(data), 0);
+    if(bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+    if(bytes <= 0) {
+        close(s, true);
+        return;
+    }
+
+    if(s.state == Querying) {
+        s.partial.insert(s.partial.end(), data, data + bytes);
+        if(std::find(s.partial.begin(), s.partial.end(), '\n') == s.partial.end())
+            return;
+
+        s.partial.push_back('\0');
+        float frequency = atof(s.partial.data());
+        if(!(frequency > 0) || !std::isfinite(frequency)) {
+            // Every timestamp divides by it, so query again later and show
+            // the server as down until it answers with a usable one.
+            emit connectionChanged(s.host, false);
+            close(s, true);
+            return;
+        }
+
+        s.frequency = frequency;
+        for(int id = s.firstID; id < s.firstID + s.ids; id++) {
+            if(fa::bus* bus = this->bus(id))
+                bus->set_frequency(s.frequency);
+        }
+
+        // Reopened right away for the subscription itself.
+        close(s, false);
+    }
+    else if(s.state == Subscribing) {
+        if(data[0] != 0) {
+            close(s, true);
+            return;
+        }
+
+        s.state = Streaming;
+        s.backoff = FA_RETRY_MIN;
+        s.received = 0;
+        s.origin = std::numeric_limits<int64_t>::max();
+        for(int id : s.mask)
+            s.start[id] = this->bus(id) ? this->bus(id)->sequence() : 0;
+        emit connectionChanged(s.host, true);
+
+        demultiplex(s, data + 1, bytes - 1);
+    }
+    else {
+        demultiplex(s, data, bytes);
+    }
+}
+
+void FaAcquisition::demultiplex(server& s, const char* data, size_t bytes)
+{
+    size_t frame = s.mask.size() * 2 * sizeof(int32_t);
+    size_t frames;
+    int64_t origin;
+
+    s.partial.insert(s.partial.end(), data, data + bytes);
+    frames = s.partial.size() / frame;
+    if(frames == 0)
+        return;
+
+    // Frames carry every subscribed BPM in id order, split them per bus.
+    this->scratch.resize(2 * frames);
+    for(size_t k = 0; k < s.mask.size(); k++) {
+        fa::bus* bus = this->bus(s.mask[k]);
+        if(!bus)
+            continue;
+        for(size_t i = 0; i < frames; i++)
+            memcpy(&this->scratch[2 * i], s.partial.data() + i * frame + k * 2 * sizeof(int32_t), 2 * sizeof(int32_t));
+        bus->publish(this->scratch.data(), frames);
+    }
+
+    s.partial.erase(s.partial.begin(), s.partial.begin() + frames * frame);
+    s.received += frames;
+
+    //
+    // Arrival time minus the duration of what has been received bounds the
+    // time of the first sample from above; the smallest bound seen is the
+    // least delayed one. Buses of every server are aligned on it.
+    //
+    origin = fa::wall_time() - int64_t(s.received * (1e9 / s.frequency));
+    if(origin < s.origin) {
+        s.origin = origin;
+        for(int id : s.mask) {
+            if(fa::bus* bus = this->bus(id))
+                bus->set_origin(origin - int64_t(s.start[id] * (1e9 / s.frequency)));
+        }
+    }
+}
@@ -0,0 +1,150 @@
+#ifndef FA_ACQUISITION_H
+#define FA_ACQUISITION_H
+
+#include <QObject>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSet>
+#include <QThreadPool>
+#include <QFutureWatcher>
+#include <QStringList>
+#include <QtConcurrent>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <netinet/in.h>
+
+#include <fa_bus.h>
+
+#define FA_RETRY_MIN        1000000000ll
+#define FA_RETRY_MAX        16000000000ll
+#define FA_CONNECT_TIMEOUT  2000000000ll
+#define FA_RESOLVE_POLL     50000000ll
+#define FA_RECV_SIZE        (1 << 16)
+#define FA_EPOLL_PERIOD     100
+
+//
+// Acquisition layer: every configured archiver is one `server` with its own
+// BPM id range and sampling frequency. All their sockets are non-blocking
+// and serviced by a single epoll loop on a worker thread. Each server runs
+// a small state machine (CF query, subscription, streaming) and reconnects
+// with exponential backoff on its own.
+//
+// Samples are demultiplexed into one fa::bus per BPM. Buses are private to
+// the process, or named POSIX shared memory in daemon mode.
+//
+class FaAcquisition : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum state_t {
+        Idle = 0,
+        Querying,
+        Subscribing,
+        Streaming
+    };
+
+    struct server
+    {
+        QString host;
+        int port;
+        int firstID;
+        int ids;
+        float frequency;
+        sockaddr_in address;
+        QFuture<bool> lookup;
+
+        int sock;
+        state_t state;
+        bool connecting;
+        std::vector<int> mask;
+        std::vector<char> partial;
+        uint64_t received;
+        std::map<int, uint64_t> start;
+        int64_t origin;
+        int64_t deadline;
+        int64_t retry;
+        int64_t backoff;
+    };
+
+    //
+    // With `shared` every BPM gets a named bus for the viewers on this host.
+    // Names already taken are left alone and listed by occupiedBuses(),
+    // unless `replace` unlinks them first.
+    //
+    explicit FaAcquisition(const QJsonObject& config, bool shared = false, bool replace = false, QObject *parent = nullptr);
+    ~FaAcquisition();
+
+    void start();
+    void stop();
+
+    // BPMs to stream, replacing the previous set. Servers whose share of the
+    // set changes resubscribe, the others keep streaming.
+    void subscribe(const QList<int>& ids);
+    void reconnect();
+
+    // BPM names of every server, in server then CL order, from the on-disk
+    // cache. refreshBPMs() queries all servers concurrently and reports a
+    // different list through bpmListChanged().
+    QStringList cachedBPMs();
+    void refreshBPMs();
+
+    QList<int> configuredIDs() const;
+    QStringList occupiedBuses() const { return this->occupied; }
+    std::string sharedName(int id);
+
+    fa::bus* bus(int id);
+    float frequency(int id);
+
+    // Newest instant every one of `ids` has samples for.
+    int64_t alignedTime(const QList<int>& ids);
+
+signals:
+    void connectionChanged(QString server, bool connected);
+    void bpmListChanged(QStringList names);
+
+private:
+    void run();
+    void open(server& s);
+    void close(server& s, bool retry);
+    void writable(server& s);
+    void readable(server& s);
+    void demultiplex(server& s, const char* data, size_t bytes);
+    void update();
+    server* find(int id);
+
+    static QString maskString(const std::vector<int>& ids);
+    static bool lookup(QString host);
+    static bool cached(QString host, int port, sockaddr_in& address);
+    static QStringList queryBPMs(QString host, int port);
+    static QString cachePath(const server& s);
+    static QStringList readCache(const server& s);
+    static void writeCache(const server& s, const QStringList& names);
+
+    std::vector<server> servers;
+    std::map<int, std::unique_ptr<fa::bus>> buses;
+    std::vector<int32_t> scratch;
+
+    QMutex mutex;
+    QSet<int> wanted;
+    bool changed;
+    bool forced;
+
+    int epfd;
+    int wakefd;
+    std::atomic<bool> running;
+    QThreadPool pool;
+    QFuture<void> worker;
+    QStringList listed;
+    QStringList occupied;
+    std::map<size_t, QStringList> lists;
+    size_t pending;
+};
+
+#endif // FA_ACQUISITION_H
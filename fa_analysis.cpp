@@ -0,0 +1,631 @@
+#include "fa_analysis.h"
+#include "fa_decimator.h"
+#include "fa_tools.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <opencv2/core/core.hpp>
+
+namespace fa
+{
+
+namespace
+{
+
+void resize(trace& out, size_t points)
+{
+    out.index.resize(points);
+    out.x.resize(points);
+    out.y.resize(points);
+}
+
+void limits(trace& out, int hidden)
+{
+    out.min = std::numeric_limits<float>::max();
+    out.max = std::numeric_limits<float>::min();
+    for(size_t i = 0; i < out.index.size(); i++) {
+        if(!(hidden & PLANE_X)) {
+            out.min = std::min(out.min, out.x[i]);
+            out.max = std::max(out.max, out.x[i]);
+        }
+        if(!(hidden & PLANE_Y)) {
+            out.min = std::min(out.min, out.y[i]);
+            out.max = std::max(out.max, out.y[i]);
+        }
+    }
+}
+
+//
+// Welch power spectral density: `segments` windows of `length` samples,
+// `hop` apart, of both traces are copied (tapered) into the rows of one
+// matrix and transformed by a DFT_ROWS call per worker. cv::dft leaves each
+// real row in CCS packing: Re0, Re1, Im1, Re2, Im2, ... The per-bin
+// averages are then split across the workers as well. Hidden planes get no
+// rows; cross spectra need both, so `phases` ignores `hidden`.
+//
+void welch(const spectrum_key& key, const float* data_x, const float* data_y,
+           const std::vector<float>& taper, std::vector<float>& batch, spectrum& out)
+{
+    size_t length = key.length;
+    int hidden = key.phases ? 0 : key.hidden;
+    const float* first = hidden & PLANE_X ? data_y : data_x;
+    int planes = 2 - bool(hidden & PLANE_X) - bool(hidden & PLANE_Y);
+    int rows = planes * key.segments;
+    size_t bins = 1 + (length > 2 ? (length - 2) / 2 : 0);
+    float norm = 2 / (key.frequency * length) / key.segments;
+
+    batch.resize(rows * length);
+    out.power_x.assign(bins, 0);
+    out.power_y.assign(bins, 0);
+    if(rows == 0)
+        return;
+
+    FA_UNCOUNTED;
+    cv::Mat matrix(rows, length, CV_32F, batch.data());
+
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+        for(int r = range.start; r < range.end; r++) {
+            const float* source = (r < key.segments ? first : data_y) + (r % key.segments) * key.hop;
+            float* row = batch.data() + r * length;
+            if(key.window) {
+                for(size_t i = 0; i < length; i++)
+                    row[i] = source[i] * taper[i];
+            }
+            else {
+                std::copy(source, source + length, row);
+            }
+        }
+        cv::Mat part = matrix.rowRange(range.start, range.end);
+        cv::dft(part, part, cv::DFT_ROWS);
+    });
+
+    if(key.phases)
+        out.rows.assign(batch.begin(), batch.begin() + rows * length);
+
+    //
+    // The first block of rows is X unless X is hidden, then Y.
+    //
+    std::vector<float>* powers[2] = {hidden & PLANE_X ? &out.power_y : &out.power_x, &out.power_y};
+    cv::parallel_for_(cv::Range(0, bins), [&](const cv::Range& range) {
+        for(int b = range.start; b < range.end; b++) {
+            for(int p = 0; p < planes; p++) {
+                double sum = 0;
+                for(int r = 0; r < key.segments; r++) {
+                    const float* row = batch.data() + (r + p * key.segments) * length;
+                    if(b == 0)
+                        sum += row[0] * row[0];
+                    else
+                        sum += row[2 * b - 1] * row[2 * b - 1] + row[2 * b] * row[2 * b];
+                }
+                (*powers[p])[b] = sum * norm;
+            }
+        }
+    });
+}
+
+//
+// Sums consecutive runs of `bins` power spectrum points, starting at
+// `first`.
+//
+template <bool Root>
+void condense(const std::vector<float>& power, size_t first, const std::vector<int>& bins, std::vector<float>& out)
+{
+    size_t start = first;
+    double sum;
+
+    out.resize(bins.size());
+    for(size_t i = 0; i < bins.size(); i++) {
+        sum = 0;
+        for(int k = 0; k < bins[i]; k++)
+            sum += power[start + k];
+        out[i] = Root ? std::sqrt(sum) : sum;
+        start += bins[i];
+    }
+}
+
+//
+// Widths of the log-spaced bins over `count` spectrum points, the positive
+// steps of int(delta^i).
+//
+void log_bins(size_t count, size_t half, std::vector<int>& bins)
+{
+    double delta = pow(10, log10(half - 2) / (half - 1));
+    int last = 1;
+    int gap;
+
+    bins.clear();
+    for(size_t i = 1; i < count; i++) {
+        gap = pow(delta, i);
+        if(gap - last > 0)
+            bins.push_back(gap - last);
+        last = gap;
+    }
+}
+
+template <int Decimation>
+void raw(const analysis_config& config, analysis_state& state, std::vector<float>& data_x, std::vector<float>& data_y, trace& out)
+{
+    size_t n = std::min(data_x.size(), data_y.size());
+    float spacing = config.ratio / 10.0;
+    (void) state;
+
+    if constexpr (Decimation == DECIMATION_1_1) {
+        resize(out, n);
+        for(size_t i = 0; i < n; i++) {
+            out.index[i] = i * spacing;
+            out.x[i] = data_x[i];
+            out.y[i] = data_y[i];
+        }
+    }
+    else {
+        resize(out, n > 0 ? n - 1 : 0);
+        for(size_t i = 1; i < n; i++) {
+            out.index[i - 1] = (i - 1) * spacing;
+            out.x[i - 1] = data_x[i] - data_x[i - 1];
+            out.y[i - 1] = data_y[i] - data_y[i - 1];
+        }
+    }
+
+    limits(out, config.hidden);
+}
+
+//
+// Segment length and hop for `segments` windows overlapping by `overlap`
+// that exactly cover `n` samples.
+//
+const spectrum& lookup(const analysis_config& config, analysis_state& state, int segments,
+                       std::vector<float>& data_x, std::vector<float>& data_y)
+{
+    size_t n = std::min(data_x.size(), data_y.size());
+    float overlap = segments > 1 ? config.overlap : 0;
+    size_t length = n / (1 + (segments - 1) * (1 - overlap));
+    size_t hop = std::max<size_t>(1, length * (1 - overlap));
+    spectrum_key key{};
+
+    if(segments > 1)
+        length = std::min(length, n - (segments - 1) * hop);
+
+    key.bpm = state.bpm;
+    key.end = state.end;
+    key.length = length;
+    key.hop = hop;
+    key.segments = segments;
+    key.window = config.window;
+    key.frequency = config.frequency;
+    key.phases = false;
+    key.hidden = config.hidden;
+    return state.cache->get(key, data_x.data(), data_y.data());
+}
+
+template <bool Squared, int Decimation>
+void fft(const analysis_config& config, analysis_state& state, std::vector<float>& data_x, std::vector<float>& data_y, trace& out)
+{
+    const int segments = Decimation == FFT_10_1 ? config.averages : 1;
+    const spectrum& power = lookup(config, state, segments, data_x, data_y);
+    float spacing = float(std::min(data_x.size(), data_y.size())) / power.key.length;
+
+    resize(out, power.power_x.size());
+    for(size_t i = 0; i < out.index.size(); i++) {
+        out.index[i] = i * spacing;
+        out.x[i] = Squared ? power.power_x[i] : std::sqrt(power.power_x[i]);
+        out.y[i] = Squared ? power.power_y[i] : std::sqrt(power.power_y[i]);
+    }
+
+    limits(out, config.hidden);
+}
+
+//
+// Band spectrum from the zoom decimator: each trace's window holds
+// FA_ZOOM_LENGTH in-phase then as many quadrature samples, the band mixed
+// down to 0 Hz and decimated by `zoom`. One complex DFT_ROWS call transforms
+// both; bin k sits at the centre plus k (or k - length past the middle)
+// times rate / length. The bins inside the band are corrected for the CIC
+// droop and scaled to the same one-sided density as the full spectrum.
+//
+template <bool Squared>
+void band(const analysis_config& config, analysis_state& state, std::vector<float>& data_x, std::vector<float>& data_y, trace& out)
+{
+    const int length = FA_ZOOM_LENGTH;
+    double centre = (config.bandLow + config.bandHigh) / 2;
+    double rate = config.frequency / config.zoom;
+    double step = rate / length;
+    int first = std::max<int>(-length / 2, std::ceil((config.bandLow - centre) / step));
+    int last = std::min<int>(length / 2 - 1, std::floor((config.bandHigh - centre) / step));
+    float norm = 2 / (rate * length);
+
+    state.baseband.resize(4 * length);
+    for(int r = 0; r < 2; r++) {
+        const float* source = (r == 0 ? data_x : data_y).data();
+        float* row = state.baseband.data() + 2 * r * length;
+        for(int i = 0; i < length; i++) {
+            float weight = config.window ? state.taper[i] : 1;
+            row[2 * i] = source[i] * weight;
+            row[2 * i + 1] = source[length + i] * weight;
+        }
+    }
+
+    {
+        FA_UNCOUNTED;
+        cv::Mat matrix(2, length, CV_32FC2, state.baseband.data());
+        cv::dft(matrix, matrix, cv::DFT_ROWS);
+    }
+
+    resize(out, std::max(0, last - first + 1));
+    for(int k = first; k <= last; k++) {
+        const float* bin_x = state.baseband.data() + 2 * ((k + length) % length);
+        const float* bin_y = bin_x + 2 * length;
+        double droop = cic::response(k * step, config.frequency, config.zoom);
+        float power_x = (bin_x[0] * bin_x[0] + bin_x[1] * bin_x[1]) * norm / (droop * droop);
+        float power_y = (bin_y[0] * bin_y[0] + bin_y[1] * bin_y[1]) * norm / (droop * droop);
+
+        out.index[k - first] = centre + k * step;
+        out.x[k - first] = Squared ? power_x : std::sqrt(power_x);
+        out.y[k - first] = Squared ? power_y : std::sqrt(power_y);
+    }
+
+    limits(out, config.hidden);
+}
+
+template <bool Filter>
+void logf(const analysis_config& config, analysis_state& state, std::vector<float>& data_x, std::vector<float>& data_y, trace& out)
+{
+    const spectrum& power = lookup(config, state, 1, data_x, data_y);
+    size_t bins = state.bins.size();
+    float filter = config.logFilter;
+
+    condense<true>(power.power_x, 0, state.bins, state.bands_x);
+    condense<true>(power.power_y, 0, state.bins, state.bands_y);
+
+    if(Filter) {
+        for(size_t i = 0; i < bins; i++) {
+            state.bands_x[i] *= state.scale[i];
+            state.bands_y[i] *= state.scale[i];
+        }
+    }
+
+    //
+    // Exponential average of the power, reset whenever the settings change.
+    // A window that was already averaged in (a frozen view being redrawn)
+    // leaves the history alone.
+    //
+    if(filter != 1) {
+        if(state.reset) {
+            state.reset = false;
+            state.history_x.assign(bins, 0);
+            state.history_y.assign(bins, 0);
+            filter = 1;
+        }
+        else if(state.averaged == state.end) {
+            filter = 0;
+        }
+
+        for(size_t i = 0; i < bins; i++) {
+            state.history_x[i] = filter * state.bands_x[i] * state.bands_x[i] + (1 - filter) * state.history_x[i];
+            state.history_y[i] = filter * state.bands_y[i] * state.bands_y[i] + (1 - filter) * state.history_y[i];
+            state.bands_x[i] = std::sqrt(state.history_x[i]);
+            state.bands_y[i] = std::sqrt(state.history_y[i]);
+        }
+        state.averaged = state.end;
+    }
+
+    resize(out, bins > 0 ? bins - 1 : 0);
+    for(size_t i = 1; i < bins; i++) {
+        out.index[i - 1] = i;
+        out.x[i - 1] = state.bands_x[i];
+        out.y[i - 1] = state.bands_y[i];
+    }
+
+    out.bins = bins;
+    limits(out, config.hidden);
+}
+
+template <bool Reverse>
+void integrated(const analysis_config& config, analysis_state& state, std::vector<float>& data_x, std::vector<float>& data_y, trace& out)
+{
+    const spectrum& power = lookup(config, state, 1, data_x, data_y);
+    size_t bins = state.bins.size();
+    float scale = config.frequency / power.key.length;
+
+    condense<false>(power.power_x, 2, state.bins, state.bands_x);
+    condense<false>(power.power_y, 2, state.bins, state.bands_y);
+
+    if(Reverse) {
+        for(size_t i = bins; i-- > 1;) {
+            state.bands_x[i - 1] += state.bands_x[i];
+            state.bands_y[i - 1] += state.bands_y[i];
+        }
+    }
+    else {
+        for(size_t i = 1; i < bins; i++) {
+            state.bands_x[i] += state.bands_x[i - 1];
+            state.bands_y[i] += state.bands_y[i - 1];
+        }
+    }
+
+    resize(out, bins > 0 ? bins - 1 : 0);
+    for(size_t i = 1; i < bins; i++) {
+        out.index[i - 1] = i;
+        out.x[i - 1] = std::sqrt(scale * state.bands_x[i]);
+        out.y[i - 1] = std::sqrt(scale * state.bands_y[i]);
+    }
+
+    out.bins = bins;
+    limits(out, config.hidden);
+}
+
+//
+// Cascaded spectrum: level j of the window holds the newest
+// FA_MULTIRATE_LENGTH samples of the 10^j:1 decimated stream, as many levels
+// as have filled up. Every level is Welch-averaged over short segments at
+// its own rate and corrected for the droop of the CIC stages in front of
+// it. It contributes from 0.4x the next level's rate up to 0.4x its own (the
+// Nyquist frequency for the full-rate one), the deepest level down to its
+// first bin. The pieces are merged into FA_MULTIRATE_DECADE log-spaced bands
+// per decade, so the x axis is in Hz.
+//
+// `Option` is "scale by F" for log-f and the reversed sum when integrated.
+//
+template <bool Integrated, bool Option>
+void multirate(const analysis_config& config, analysis_state& state, std::vector<float>& data_x, std::vector<float>& data_y, trace& out)
+{
+    size_t n = std::min(data_x.size(), data_y.size());
+    int levels = std::min<size_t>(n / FA_MULTIRATE_LENGTH, FA_MULTIRATE_LEVELS);
+    int segments = (FA_MULTIRATE_LENGTH - FA_MULTIRATE_SEGMENT) / (FA_MULTIRATE_SEGMENT / 2) + 1;
+    double lowest = config.frequency / std::pow(10, levels - 1) / FA_MULTIRATE_SEGMENT;
+    size_t bands = levels > 0 ? std::log10(config.frequency / 2 / lowest) * FA_MULTIRATE_DECADE + 1 : 0;
+    uint64_t ratio = 1;
+    size_t points = 0;
+    float filter = config.logFilter;
+
+    state.bands_x.assign(bands, 0);
+    state.bands_y.assign(bands, 0);
+    state.widths.assign(bands, 0);
+
+    for(int j = 0; j < levels; j++, ratio *= 10) {
+        double rate = config.frequency / ratio;
+        double step = rate / FA_MULTIRATE_SEGMENT;
+        double high = j == 0 ? rate / 2 : 0.4 * rate;
+        double low = j == levels - 1 ? step : 0.04 * rate;
+        spectrum_key key{};
+        key.bpm = state.bpm;
+        key.end = state.end / ratio;
+        key.length = FA_MULTIRATE_SEGMENT;
+        key.hop = FA_MULTIRATE_SEGMENT / 2;
+        key.segments = segments;
+        key.window = config.window;
+        key.frequency = float(rate);
+        key.phases = false;
+        key.hidden = config.hidden;
+        const spectrum& power = state.cache->get(key, data_x.data() + j * FA_MULTIRATE_LENGTH,
+                                                 data_y.data() + j * FA_MULTIRATE_LENGTH);
+        size_t first = std::max<size_t>(1, std::ceil(low / step));
+        size_t last = std::min<size_t>(power.power_x.size(), std::ceil(high / step));
+
+        for(size_t b = first; b < last; b++) {
+            double frequency = b * step;
+            double droop = 1;
+            for(int k = 0; k < j; k++)
+                droop *= cic::response(frequency, config.frequency / std::pow(10, k));
+
+            size_t band = std::min<size_t>(bands - 1, std::log10(frequency / lowest) * FA_MULTIRATE_DECADE);
+            state.bands_x[band] += power.power_x[b] * step / (droop * droop);
+            state.bands_y[band] += power.power_y[b] * step / (droop * droop);
+            state.widths[band] += step;
+        }
+    }
+
+    //
+    // Mean power density per band, empty bands (below the resolution of
+    // the level covering them) are dropped. `widths` is reused for the band
+    // centres.
+    //
+    for(size_t i = 0; i < bands; i++) {
+        if(state.widths[i] == 0)
+            continue;
+        state.bands_x[points] = Integrated ? state.bands_x[i] : state.bands_x[i] / state.widths[i];
+        state.bands_y[points] = Integrated ? state.bands_y[i] : state.bands_y[i] / state.widths[i];
+        state.widths[points] = lowest * std::pow(10, (i + 0.5) / FA_MULTIRATE_DECADE);
+        points++;
+    }
+
+    resize(out, points);
+
+    if(Integrated) {
+        if(Option) {
+            for(size_t i = points; i-- > 1;) {
+                state.bands_x[i - 1] += state.bands_x[i];
+                state.bands_y[i - 1] += state.bands_y[i];
+            }
+        }
+        else {
+            for(size_t i = 1; i < points; i++) {
+                state.bands_x[i] += state.bands_x[i - 1];
+                state.bands_y[i] += state.bands_y[i - 1];
+            }
+        }
+    }
+    else if(filter != 1) {
+        if(state.reset || state.history_x.size() != points) {
+            state.reset = false;
+            state.history_x.assign(points, 0);
+            state.history_y.assign(points, 0);
+            filter = 1;
+        }
+        else if(state.averaged == state.end) {
+            filter = 0;
+        }
+
+        for(size_t i = 0; i < points; i++) {
+            state.history_x[i] = filter * state.bands_x[i] + (1 - filter) * state.history_x[i];
+            state.history_y[i] = filter * state.bands_y[i] + (1 - filter) * state.history_y[i];
+            state.bands_x[i] = state.history_x[i];
+            state.bands_y[i] = state.history_y[i];
+        }
+        state.averaged = state.end;
+    }
+
+    for(size_t i = 0; i < points; i++) {
+        float scale = !Integrated && Option ? state.widths[i] : 1;
+        out.index[i] = state.widths[i];
+        out.x[i] = std::sqrt(state.bands_x[i]) * scale;
+        out.y[i] = std::sqrt(state.bands_y[i]) * scale;
+    }
+
+    limits(out, config.hidden);
+}
+
+analysis::kernel_t select(const analysis_config& config)
+{
+    if(config.multirate && config.mode == MODE_FFT_LOGF)
+        return config.filter ? multirate<false, true> : multirate<false, false>;
+    else if(config.multirate && config.mode == MODE_INTEGRATED)
+        return config.reverse ? multirate<true, true> : multirate<true, false>;
+
+    if(config.mode == MODE_FFT && config.zoom > 0)
+        return config.squared ? band<true> : band<false>;
+    else if(config.mode == MODE_FFT) {
+        if(config.decimation == FFT_10_1)
+            return config.squared ? fft<true, FFT_10_1> : fft<false, FFT_10_1>;
+        return config.squared ? fft<true, FFT_1_1> : fft<false, FFT_1_1>;
+    }
+    else if(config.mode == MODE_FFT_LOGF)
+        return config.filter ? logf<true> : logf<false>;
+    else if(config.mode == MODE_INTEGRATED)
+        return config.reverse ? integrated<true> : integrated<false>;
+    else if(config.decimation == DECIMATION_DIFF)
+        return raw<DECIMATION_DIFF>;
+    return raw<DECIMATION_1_1>;
+}
+
+}
+
+bool spectrum_key::operator==(const spectrum_key& other) const
+{
+    return bpm == other.bpm && end == other.end && length == other.length && hop == other.hop &&
+           segments == other.segments && window == other.window && frequency == other.frequency &&
+           phases == other.phases && hidden == other.hidden;
+}
+
+spectrum_cache::spectrum_cache(size_t entries) : entries(entries), clock(0), nhits(0), nmisses(0)
+{
+    clear();
+}
+
+void spectrum_cache::clear()
+{
+    for(auto& entry : entries) {
+        entry.key.length = 0;
+        entry.used = 0;
+    }
+}
+
+const spectrum& spectrum_cache::get(const spectrum_key& key, const float* data_x, const float* data_y)
+{
+    spectrum* oldest = &entries.front();
+
+    for(auto& entry : entries) {
+        spectrum_key wanted = key;
+        wanted.hidden = entry.key.hidden;
+        if(entry.key.length > 0 && entry.key == wanted && (entry.key.hidden & ~key.hidden) == 0) {
+            entry.used = ++clock;
+            nhits++;
+            return entry;
+        }
+        if(entry.used < oldest->used)
+            oldest = &entry;
+    }
+
+    nmisses++;
+    oldest->key = key;
+    oldest->used = ++clock;
+
+    if(key.window && taper.size() != key.length) {
+        float delta = (M_PI - -M_PI) / (key.length - 1);
+        taper.resize(key.length);
+        for(size_t i = 0; i < key.length; i++)
+            taper[i] = 1 + cos(-M_PI + delta * i);
+    }
+
+    welch(key, data_x, data_y, taper, batch, *oldest);
+    return *oldest;
+}
+
+bool analysis_config::operator==(const analysis_config& other) const
+{
+    return mode == other.mode && decimation == other.decimation && ratio == other.ratio && window == other.window &&
+           squared == other.squared && filter == other.filter && linear == other.linear &&
+           reverse == other.reverse && multirate == other.multirate && samples == other.samples && averages == other.averages &&
+           overlap == other.overlap && logFilter == other.logFilter && frequency == other.frequency &&
+           bandLow == other.bandLow && bandHigh == other.bandHigh && zoom == other.zoom &&
+           orbitSpectrum == other.orbitSpectrum && phase == other.phase && hidden == other.hidden;
+}
+
+analysis::analysis() : settings(), kernel(raw<DECIMATION_1_1>)
+{
+    settings.mode = -1;
+    state.cache = &own;
+    state.bpm = -1;
+    state.end = 0;
+    state.averaged = 0;
+    state.reset = true;
+}
+
+void analysis::configure(const analysis_config& config)
+{
+    settings = config;
+    kernel = select(settings);
+    prepare();
+}
+
+void analysis::set_cache(spectrum_cache* cache)
+{
+    state.cache = cache ? cache : &own;
+}
+
+void analysis::set_frequency(float frequency)
+{
+    if(frequency == settings.frequency)
+        return;
+
+    settings.frequency = frequency;
+    prepare();
+}
+
+void analysis::prepare()
+{
+    size_t half = settings.samples / 2;
+    int sum = 0;
+
+    state.reset = true;
+    state.bins.clear();
+    state.scale.clear();
+
+    if(settings.mode == MODE_FFT_LOGF && !settings.multirate)
+        log_bins(half, half, state.bins);
+    else if(settings.mode == MODE_INTEGRATED && !settings.multirate)
+        log_bins(half - 1, half, state.bins);
+
+    for(int bin : state.bins) {
+        sum += bin;
+        state.scale.push_back(settings.frequency * sum / settings.samples);
+    }
+
+    if(settings.mode == MODE_FFT && settings.zoom > 0 && settings.window) {
+        float delta = (M_PI - -M_PI) / (FA_ZOOM_LENGTH - 1);
+        state.taper.resize(FA_ZOOM_LENGTH);
+        for(size_t i = 0; i < FA_ZOOM_LENGTH; i++)
+            state.taper[i] = 1 + cos(-M_PI + delta * i);
+    }
+}
+
+void analysis::run(int bpm, uint64_t end, std::vector<float>& data_x, std::vector<float>& data_y, trace& out)
+{
+    state.bpm = bpm;
+    state.end = end;
+    out.bins = 0;
+    kernel(settings, state, data_x, data_y, out);
+}
+
+}
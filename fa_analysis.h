@@ -0,0 +1,219 @@
+#ifndef FA_ANALYSIS_H
+#define FA_ANALYSIS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define MODE_RAW            0
+#define MODE_FFT            1
+#define MODE_FFT_LOGF       2
+#define MODE_INTEGRATED     3
+#define MODE_ORBIT          4
+#define MODE_COHERENCE      5
+
+#define COHERENCE_SCAN      -1
+#define COHERENCE_XY        0
+
+#define DECIMATION_1_1      0
+#define DECIMATION_DIFF     2
+
+#define FFT_1_1     0
+#define FFT_10_1    1
+
+#define PLANE_X     1
+#define PLANE_Y     2
+
+#define FA_SPECTRUM_CACHE   8
+
+#define FA_MULTIRATE_LEVELS     4
+#define FA_MULTIRATE_LENGTH     4096
+#define FA_MULTIRATE_SEGMENT    1024
+#define FA_MULTIRATE_DECADE     50
+
+namespace fa
+{
+
+//
+// Snapshot of the analysis settings, taken from the widgets whenever one of
+// them changes. `decimation` is one of DECIMATION_* in MODE_RAW and FFT_* in
+// MODE_FFT, resolved from the combo box text so it does not depend on which
+// items the time range left in it. In MODE_RAW the window comes from the
+// `ratio`:1 decimated ring. The averaged FFT splits the window into
+// `averages` segments overlapping by the fraction `overlap`. `multirate`
+// switches log-f and integrated to the cascaded spectrum, whose window is
+// made of FA_MULTIRATE_LENGTH samples of each decimation level. A non-zero
+// `zoom` turns MODE_FFT into the band spectrum of [bandLow, bandHigh] (Hz),
+// whose window is the baseband of fa::zoom decimated by that ratio.
+// MODE_ORBIT does not analyse a window: `decimation` is the rank of the
+// orbit mode shown, as its shape or, with `orbitSpectrum`, its spectrum.
+// Nor does MODE_COHERENCE, where `decimation` is the id of the BPM paired
+// with the current one, COHERENCE_XY or COHERENCE_SCAN, and `phase` shows
+// the cross-spectrum phase instead of the coherence. `hidden` (PLANE_*
+// bits) are the planes nobody looks at: their spectra are not computed and
+// come out as zeros, left out of the trace limits.
+//
+struct analysis_config
+{
+    int   mode;
+    int   decimation;
+    int   ratio;
+    bool  window;
+    bool  squared;
+    bool  filter;
+    bool  linear;
+    bool  reverse;
+    bool  multirate;
+    int   samples;
+    int   averages;
+    float overlap;
+    float logFilter;
+    float frequency;
+    float bandLow;
+    float bandHigh;
+    int   zoom;
+    bool  orbitSpectrum;
+    bool  phase;
+    int   hidden;
+
+    bool operator==(const analysis_config& other) const;
+    bool operator!=(const analysis_config& other) const { return !(*this == other); }
+};
+
+//
+// One analysed window, ready to be turned into chart points: `index` is the
+// shared abscissa, `x` and `y` the horizontal and vertical traces. `bins` is
+// the number of log-spaced bins in the log-f and integrated modes.
+//
+struct trace
+{
+    std::vector<float> index;
+    std::vector<float> x;
+    std::vector<float> y;
+    float  min;
+    float  max;
+    size_t bins;
+};
+
+//
+// A window is identified by its BPM and the absolute index one past its
+// last sample. It is split into `segments` of `length` samples starting
+// `hop` apart, whose spectra are averaged. With `phases` the complex
+// spectra of the segments are kept as well, for cross spectra. The
+// `hidden` planes (PLANE_* bits) are skipped, their power left at zero;
+// an entry with fewer hidden planes serves the request as well.
+//
+struct spectrum_key
+{
+    int      bpm;
+    uint64_t end;
+    size_t   length;
+    size_t   hop;
+    int      segments;
+    bool     window;
+    float    frequency;
+    bool     phases;
+    int      hidden;
+
+    bool operator==(const spectrum_key& other) const;
+};
+
+//
+// Power spectral density (um^2/Hz) of a window, averaged over its segments.
+// Every spectral view (FFT, log-f, integrated) is derived from it. `rows`
+// holds the CCS-packed spectra of the X then the Y segments when the key
+// asks for phases.
+//
+struct spectrum
+{
+    spectrum_key key;
+    std::vector<float> power_x;
+    std::vector<float> power_y;
+    std::vector<float> rows;
+    uint64_t used;
+};
+
+//
+// The last few spectra, least recently used first out. Entries and the
+// transform matrix are reused in place, so a warm cache does not allocate.
+//
+class spectrum_cache
+{
+public:
+    explicit spectrum_cache(size_t entries = FA_SPECTRUM_CACHE);
+
+    // Transforms the windows on a miss only. Both hold at least
+    // (segments - 1) * hop + length samples.
+    const spectrum& get(const spectrum_key& key, const float* data_x, const float* data_y);
+    void clear();
+
+    size_t hits()   const { return nhits; }
+    size_t misses() const { return nmisses; }
+
+private:
+    std::vector<spectrum> entries;
+    std::vector<float> batch;
+    std::vector<float> taper;
+    uint64_t clock;
+    size_t nhits;
+    size_t nmisses;
+};
+
+struct analysis_state
+{
+    spectrum_cache* cache;
+    int      bpm;
+    uint64_t end;
+    uint64_t averaged;
+
+    std::vector<int>   bins;
+    std::vector<float> scale;
+    std::vector<float> history_x;
+    std::vector<float> history_y;
+    std::vector<float> bands_x;
+    std::vector<float> bands_y;
+    std::vector<float> widths;
+    std::vector<float> taper;
+    std::vector<float> baseband;
+    bool reset;
+};
+
+//
+// Every (mode, decimation, window, squared / filter / reverse) combination
+// is its own instantiation of a templated kernel, so the per-sample loops
+// carry no widget lookups, string compares or mode tests. configure() picks
+// the kernel and precomputes what only depends on the settings (log-f bin
+// widths, "scale by F" factors); run() is then a single indirect call.
+//
+// The spectral modes fetch the window's spectrum from a cache, which can be
+// shared between several analyses. Switching modes on a frozen window, or
+// showing the same window in several modes, transforms it only once.
+//
+class analysis
+{
+public:
+    typedef void (*kernel_t)(const analysis_config& config, analysis_state& state,
+                             std::vector<float>& data_x, std::vector<float>& data_y, trace& out);
+
+    analysis();
+
+    void configure(const analysis_config& config);
+    void set_frequency(float frequency);
+    void set_cache(spectrum_cache* cache);
+    const analysis_config& config() const { return settings; }
+
+    // Analyses the window of `bpm` ending at sample `end`.
+    void run(int bpm, uint64_t end, std::vector<float>& data_x, std::vector<float>& data_y, trace& out);
+
+private:
+    void prepare();
+
+    analysis_config settings;
+    analysis_state state;
+    spectrum_cache own;
+    kernel_t kernel;
+};
+
+}
+
+#endif // FA_ANALYSIS_H
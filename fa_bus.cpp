@@ -0,0 +1,169 @@
+#include "fa_bus.h"
+#include "fa_history.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define FA_BUS_HEADER   64
+
+namespace fa
+{
+
+bus::bus() : header(nullptr), ring(nullptr), size(0), owner(false)
+{
+}
+
+bus::~bus()
+{
+    detach();
+}
+
+std::string bus::name(const std::string& host, int port, int id)
+{
+    return "/fa-viewer-" + host + "-" + std::to_string(port) + "-" + std::to_string(id);
+}
+
+bool bus::create(const std::string& name, int id, float frequency, bool replace)
+{
+    int fd;
+    void* memory;
+
+    detach();
+    size = FA_BUS_HEADER + FA_BUS_SAMPLES * 2 * 2 * sizeof(int32_t);
+
+    if(name.empty()) {
+        memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if(memory == MAP_FAILED)
+            return false;
+    }
+    else {
+        if(replace)
+            ::shm_unlink(name.c_str());
+        fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if(fd < 0)
+            return false;
+
+        if(::ftruncate(fd, size) != 0) {
+            ::close(fd);
+            ::shm_unlink(name.c_str());
+            return false;
+        }
+
+        memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(memory == MAP_FAILED) {
+            ::shm_unlink(name.c_str());
+            return false;
+        }
+    }
+
+    header = new (memory) bus_header;
+    header->capacity = FA_BUS_SAMPLES;
+    header->id = id;
+    header->frequency.store(frequency, std::memory_order_relaxed);
+    header->sequence.store(0, std::memory_order_relaxed);
+    header->heartbeat.store(wall_time(), std::memory_order_relaxed);
+    header->origin.store(wall_time(), std::memory_order_relaxed);
+    ring = (int32_t*) ((char*) memory + FA_BUS_HEADER);
+    owner = true;
+    path = name;
+
+    // Published last, readers refuse to attach until the header is complete.
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = FA_BUS_MAGIC;
+    return true;
+}
+
+bool bus::attach(const std::string& name)
+{
+    int fd;
+    void* memory;
+
+    detach();
+    fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if(fd < 0)
+        return false;
+
+    size = FA_BUS_HEADER + FA_BUS_SAMPLES * 2 * 2 * sizeof(int32_t);
+    memory = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(memory == MAP_FAILED)
+        return false;
+
+    header = (bus_header*) memory;
+    ring = (int32_t*) ((char*) memory + FA_BUS_HEADER);
+    owner = false;
+    path = name;
+
+    if(header->magic != FA_BUS_MAGIC || header->capacity != FA_BUS_SAMPLES || stale()) {
+        detach();
+        return false;
+    }
+
+    return true;
+}
+
+void bus::detach()
+{
+    if(!header)
+        return;
+
+    ::munmap(header, size);
+    if(owner && !path.empty())
+        ::shm_unlink(path.c_str());
+
+    header = nullptr;
+    ring = nullptr;
+    owner = false;
+}
+
+bool bus::stale() const
+{
+    return wall_time() - header->heartbeat.load(std::memory_order_relaxed) > FA_BUS_TIMEOUT;
+}
+
+void bus::publish(const int32_t* samples, size_t count)
+{
+    uint64_t sequence = header->sequence.load(std::memory_order_relaxed);
+
+    for(size_t i = 0; i < count; i++) {
+        size_t slot = (sequence + i) % FA_BUS_SAMPLES;
+        memcpy(ring + 2 * slot, samples + 2 * i, 2 * sizeof(int32_t));
+        memcpy(ring + 2 * (slot + FA_BUS_SAMPLES), samples + 2 * i, 2 * sizeof(int32_t));
+    }
+
+    header->sequence.store(sequence + count, std::memory_order_release);
+    header->heartbeat.store(wall_time(), std::memory_order_relaxed);
+}
+
+int64_t bus::time_at(uint64_t sequence) const
+{
+    return origin() + int64_t(sequence * (1e9 / frequency()));
+}
+
+uint64_t bus::sequence_at(int64_t time) const
+{
+    if(time <= origin())
+        return 0;
+    return std::min<uint64_t>(uint64_t((time - origin()) * (frequency() / 1e9)), sequence());
+}
+
+const int32_t* bus::fetch(uint64_t& last, size_t& count) const
+{
+    uint64_t sequence = header->sequence.load(std::memory_order_acquire);
+
+    if(last > sequence || sequence - last > FA_BUS_SAMPLES / 2)
+        last = sequence - std::min<uint64_t>(sequence, FA_BUS_SAMPLES / 2);
+
+    count = sequence - last;
+    const int32_t* data = ring + 2 * (last % FA_BUS_SAMPLES);
+    last = sequence;
+    return data;
+}
+
+}
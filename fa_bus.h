@@ -0,0 +1,86 @@
+#ifndef FA_BUS_H
+#define FA_BUS_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#define FA_BUS_SAMPLES  (1 << 17)
+#define FA_BUS_MAGIC    0x53554246  // "FBUS"
+#define FA_BUS_TIMEOUT  2000000000ll
+
+namespace fa
+{
+
+//
+// One BPM's stream in POSIX shared memory, published by the acquisition
+// daemon and mapped read-only by every viewer on the host.
+//
+// The payload is the archiver wire format (int32 X, int32 Y in nm per
+// sample) in a mirrored ring like fa::buffer, so any span of up to
+// `capacity` samples is contiguous. The writer fills the slots and then
+// bumps `sequence` with release semantics; readers load it with acquire and
+// consume [last, sequence) in place.
+//
+// `origin` is the wall time (ns) the stream's sample 0 would have been
+// taken at, so sequences of buses fed by different servers can be aligned.
+// An empty name creates a private (anonymous) bus for in-process use.
+// create() fails with errno EEXIST when the name is taken, by a running
+// daemon or one that did not exit cleanly, unless told to replace it.
+//
+struct bus_header
+{
+    uint32_t magic;
+    uint32_t capacity;
+    uint32_t id;
+    std::atomic<float>    frequency;
+    std::atomic<uint64_t> sequence;
+    std::atomic<int64_t>  heartbeat;
+    std::atomic<int64_t>  origin;
+};
+
+class bus
+{
+public:
+    bus();
+    ~bus();
+
+    static std::string name(const std::string& host, int port, int id);
+
+    bool create(const std::string& name, int id, float frequency, bool replace = false);
+    bool attach(const std::string& name);
+    void detach();
+
+    bool attached() const { return header != nullptr; }
+    bool stale() const;
+
+    // Writer side: `count` interleaved X/Y pairs.
+    void publish(const int32_t* samples, size_t count);
+
+    // Reader side: samples published since `last`, at most half a ring
+    // behind so the writer never laps what is being read. Updates `last`.
+    const int32_t* fetch(uint64_t& last, size_t& count) const;
+
+    float frequency() const { return header->frequency.load(std::memory_order_relaxed); }
+    uint64_t sequence() const { return header->sequence.load(std::memory_order_acquire); }
+    int64_t origin() const { return header->origin.load(std::memory_order_relaxed); }
+
+    void set_frequency(float frequency) { header->frequency.store(frequency, std::memory_order_relaxed); }
+    void set_origin(int64_t origin) { header->origin.store(origin, std::memory_order_relaxed); }
+
+    // Wall time of a sequence number and back, using origin and frequency.
+    int64_t  time_at(uint64_t sequence) const;
+    uint64_t sequence_at(int64_t time) const;
+
+private:
+    bus_header* header;
+    int32_t* ring;
+    size_t size;
+    bool owner;
+    std::string path;
+};
+
+}
+
+#endif // FA_BUS_H
@@ -0,0 +1,161 @@
+#include "fa_cross.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <opencv2/core/core.hpp>
+
+namespace fa
+{
+
+namespace
+{
+
+//
+// Coherence of `bin` between the CCS rows of `a` and `b`, `stride`
+// floats apart, with the phase of their cross spectrum (degrees).
+//
+float cross(const float* a, const float* b, size_t stride, int segments, size_t bin, float* phase)
+{
+    double re = 0;
+    double im = 0;
+    double power_a = 0;
+    double power_b = 0;
+
+    for(int k = 0; k < segments; k++) {
+        const float* row_a = a + k * stride;
+        const float* row_b = b + k * stride;
+        float ra = row_a[bin == 0 ? 0 : 2 * bin - 1];
+        float rb = row_b[bin == 0 ? 0 : 2 * bin - 1];
+        float ia = bin == 0 ? 0 : row_a[2 * bin];
+        float ib = bin == 0 ? 0 : row_b[2 * bin];
+        re += ra * rb + ia * ib;
+        im += ra * ib - ia * rb;
+        power_a += ra * ra + ia * ia;
+        power_b += rb * rb + ib * ib;
+    }
+
+    if(phase)
+        *phase = std::atan2(im, re) * 180 / M_PI;
+    return power_a > 0 && power_b > 0 ? (re * re + im * im) / (power_a * power_b) : 0;
+}
+
+}
+
+coherence::coherence() : cache(0), rows(0), length(0), segment(0), rate(0), solved(0)
+{
+}
+
+void coherence::resize(size_t bpms, size_t length)
+{
+    if(bpms != this->rows)
+        cache = spectrum_cache(bpms);
+
+    this->rows = bpms;
+    this->length = length;
+    planes[0].resize(bpms * length);
+    planes[1].resize(bpms * length);
+}
+
+void coherence::solve(float rate)
+{
+    segment = 2 * length / (FA_COHERENCE_SEGMENTS + 1);
+    if(rows == 0 || segment < 4)
+        return;
+
+    //
+    // One entry per BPM: the cache transforms every row once per window,
+    // the segments of each transform running on all cores.
+    //
+    this->rate = rate;
+    solved++;
+    spectra.resize(rows);
+    for(size_t i = 0; i < rows; i++) {
+        spectrum_key key{};
+        key.bpm = int(i);
+        key.end = solved;
+        key.length = segment;
+        key.hop = segment / 2;
+        key.segments = FA_COHERENCE_SEGMENTS;
+        key.window = true;
+        key.frequency = rate;
+        key.phases = true;
+        key.hidden = 0;
+        spectra[i] = &cache.get(key, planes[0].data() + i * length, planes[1].data() + i * length);
+    }
+}
+
+void coherence::pair(size_t reference, size_t row, bool phase, trace& out) const
+{
+    size_t bins = ready() ? spectra[row]->power_x.size() : 0;
+    size_t stride = segment;
+
+    // The DC bin has no place on the log axis.
+    out.index.resize(bins > 0 ? bins - 1 : 0);
+    out.x.resize(out.index.size());
+    out.y.resize(out.index.size());
+    out.min = std::numeric_limits<float>::max();
+    out.max = -std::numeric_limits<float>::max();
+    out.bins = 0;
+    if(bins == 0)
+        return;
+
+    // A BPM against itself is its X against its Y, in both traces.
+    const float* a_x = spectra[reference]->rows.data();
+    const float* a_y = a_x + FA_COHERENCE_SEGMENTS * stride;
+    const float* b_x = row == reference ? a_y : spectra[row]->rows.data();
+    const float* b_y = b_x + FA_COHERENCE_SEGMENTS * stride;
+
+    for(size_t b = 1; b < bins; b++) {
+        float angle_x;
+        float value_x = cross(a_x, b_x, stride, FA_COHERENCE_SEGMENTS, b, &angle_x);
+        float angle_y = angle_x;
+        float value_y = value_x;
+        if(row != reference)
+            value_y = cross(a_y, b_y, stride, FA_COHERENCE_SEGMENTS, b, &angle_y);
+
+        out.index[b - 1] = b * rate / segment;
+        out.x[b - 1] = phase ? angle_x : value_x;
+        out.y[b - 1] = phase ? angle_y : value_y;
+        out.min = std::min(out.min, std::min(out.x[b - 1], out.y[b - 1]));
+        out.max = std::max(out.max, std::max(out.x[b - 1], out.y[b - 1]));
+    }
+}
+
+void coherence::scan(size_t reference, float low, float high, trace& out) const
+{
+    size_t bins = ready() ? spectra[reference]->power_x.size() : 0;
+    size_t first = bins > 0 ? std::min<size_t>(bins - 1, std::max<size_t>(1, std::ceil(low * segment / rate))) : 0;
+    size_t last = bins > 0 ? std::min<size_t>(bins - 1, std::max<size_t>(first, std::floor(high * segment / rate))) : 0;
+    size_t stride = segment;
+
+    out.index.resize(bins > 0 ? rows : 0);
+    out.x.resize(out.index.size());
+    out.y.resize(out.index.size());
+
+    // The pairs are independent, one worker takes a range of BPMs.
+    cv::parallel_for_(cv::Range(0, out.index.size()), [&](const cv::Range& range) {
+        const float* a_x = spectra[reference]->rows.data();
+        const float* a_y = a_x + FA_COHERENCE_SEGMENTS * stride;
+        for(int i = range.start; i < range.end; i++) {
+            const float* b_x = spectra[i]->rows.data();
+            const float* b_y = b_x + FA_COHERENCE_SEGMENTS * stride;
+            double sum_x = 0;
+            double sum_y = 0;
+            for(size_t b = first; b <= last; b++) {
+                sum_x += cross(a_x, b_x, stride, FA_COHERENCE_SEGMENTS, b, nullptr);
+                sum_y += cross(a_y, b_y, stride, FA_COHERENCE_SEGMENTS, b, nullptr);
+            }
+            out.index[i] = i;
+            out.x[i] = sum_x / (last - first + 1);
+            out.y[i] = sum_y / (last - first + 1);
+        }
+    });
+
+    out.min = 0;
+    out.max = 1;
+    out.bins = 0;
+}
+
+}
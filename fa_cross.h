@@ -0,0 +1,63 @@
+#ifndef FA_CROSS_H
+#define FA_CROSS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include <fa_analysis.h>
+
+#define FA_COHERENCE_SEGMENTS   16
+
+namespace fa
+{
+
+//
+// Cross-spectral analysis of a window of all BPMs. Each BPM's window goes
+// once through a Welch spectrum that keeps the complex spectra of its
+// segments, every pair then only averages conj(A) B over the segments:
+//
+//     coherence = |Sab|^2 / (Saa Sbb),  phase = arg(Sab)
+//
+// A coherence near 1 means that the two signals move together at that
+// frequency, the phase (degrees) is negative where B lags A. Pairs are
+// evaluated on demand from the spectra of the last solve(), those of a
+// reference against every other BPM in parallel.
+//
+class coherence
+{
+public:
+    coherence();
+
+    // Window of `length` samples of `bpms` BPMs. plane(axis) then holds
+    // one row per BPM (um), to be filled before solve().
+    void resize(size_t bpms, size_t length);
+    std::vector<float>& plane(int axis) { return planes[axis]; }
+
+    void solve(float rate);
+
+    bool   ready() const { return solved > 0; }
+    size_t bpms()  const { return rows; }
+
+    // Coherence, or the phase, of BPM `row` against BPM `reference` per
+    // plane against Hz. A BPM paired with itself gives X against Y.
+    void pair(size_t reference, size_t row, bool phase, trace& out) const;
+
+    // Coherence of every BPM with `reference`, averaged over [low, high]
+    // (Hz), per plane.
+    void scan(size_t reference, float low, float high, trace& out) const;
+
+private:
+    std::vector<float> planes[2];
+    std::vector<const spectrum*> spectra;
+    spectrum_cache cache;
+    size_t rows;
+    size_t length;
+    size_t segment;
+    float rate;
+    uint64_t solved;
+};
+
+}
+
+#endif // FA_CROSS_H
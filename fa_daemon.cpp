@@ -0,0 +1,62 @@
+#include "fa_daemon.h"
+
+#include <iostream>
+using std::cout;
+using std::endl;
+
+FaDaemon::FaDaemon(QString configFile, bool replace, QObject *parent)
+    : QObject(parent),
+      configFile(configFile),
+      replace(replace),
+      acquisition(nullptr)
+{
+}
+
+FaDaemon::~FaDaemon()
+{
+}
+
+bool FaDaemon::start()
+{
+    QFile file(this->configFile);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        cout << "Could not open FA configuration file." << endl;
+        return false;
+    }
+
+    QTextStream config(&file);
+    QJsonObject object = QJsonDocument::fromJson(QString(config.readAll()).toUtf8()).object();
+    if(((object.value("ip_address").isNull() || object.value("port").isNull()) && object.value("servers").isNull()) ||
+       object.value("ids").isNull() || object.value("first_id").isNull()) {
+        cout << "Error parsing configuration file." << endl;
+        return false;
+    }
+
+    this->acquisition = new FaAcquisition(object, true, this->replace, this);
+    QObject::connect(this->acquisition, &FaAcquisition::connectionChanged, this, &FaDaemon::onConnectionChanged);
+
+    // Taking over another daemon's buses would cut its viewers off.
+    QStringList occupied = this->acquisition->occupiedBuses();
+    if(!occupied.isEmpty()) {
+        cout << "Shared memory bus " << occupied.first().toStdString() << " and " << occupied.size() - 1
+             << " more already exist: another daemon is running, or one did not exit cleanly." << endl;
+        cout << "Stop it, or start with --daemon --force to replace the buses." << endl;
+        return false;
+    }
+
+    QList<int> ids = this->acquisition->configuredIDs();
+    if(ids.isEmpty()) {
+        cout << "Could not create the shared memory buses." << endl;
+        return false;
+    }
+
+    this->acquisition->subscribe(ids);
+    this->acquisition->start();
+    cout << "Publishing " << ids.size() << " BPMs" << endl;
+    return true;
+}
+
+void FaDaemon::onConnectionChanged(QString server, bool connected)
+{
+    cout << "FA server " << server.toStdString() << (connected ? " connected" : " disconnected, reconnecting ...") << endl;
+}
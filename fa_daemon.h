@@ -0,0 +1,37 @@
+#ifndef FA_DAEMON_H
+#define FA_DAEMON_H
+
+#include <QObject>
+#include <QFile>
+#include <QTextStream>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <fa_acquisition.h>
+
+//
+// Acquisition daemon: one subscription per archiver to every configured
+// BPM, each BPM republished on its own shared-memory bus for the viewers on
+// this host. Buses left by another daemon are only replaced when asked
+// to (`--force`).
+//
+class FaDaemon : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FaDaemon(QString configFile, bool replace = false, QObject *parent = nullptr);
+    ~FaDaemon();
+
+    bool start();
+
+private slots:
+    void onConnectionChanged(QString server, bool connected);
+
+private:
+    QString configFile;
+    bool replace;
+    FaAcquisition* acquisition;
+};
+
+#endif // FA_DAEMON_H
@@ -0,0 +1,194 @@
+#include "fa_decimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace fa
+{
+
+cic::cic(int ratio) : ratio(ratio), gain(int64_t(ratio) * ratio * ratio)
+{
+    clear();
+}
+
+void cic::clear()
+{
+    for(int i = 0; i < FA_CIC_ORDER; i++) {
+        integrator[i] = 0;
+        comb[i] = 0;
+    }
+    phase = 0;
+}
+
+bool cic::step(int64_t value, int64_t& out)
+{
+    uint64_t sum;
+    uint64_t delayed;
+
+    integrator[0] += uint64_t(value);
+    for(int i = 1; i < FA_CIC_ORDER; i++)
+        integrator[i] += integrator[i - 1];
+
+    if(++phase < ratio)
+        return false;
+    phase = 0;
+
+    sum = integrator[FA_CIC_ORDER - 1];
+    for(int i = 0; i < FA_CIC_ORDER; i++) {
+        delayed = comb[i];
+        comb[i] = sum;
+        sum -= delayed;
+    }
+
+    out = int64_t(sum);
+    return true;
+}
+
+bool cic::push(int64_t value, int64_t& out)
+{
+    if(!step(value, out))
+        return false;
+
+    // Rounded division by the R^N gain.
+    out = (out >= 0 ? out + gain / 2 : out - gain / 2) / gain;
+    return true;
+}
+
+bool cic::push(int64_t value, double& out)
+{
+    int64_t sum;
+
+    if(!step(value, sum))
+        return false;
+
+    out = double(sum) / gain;
+    return true;
+}
+
+double cic::response(double frequency, double rate, int ratio)
+{
+    double x = M_PI * frequency / rate;
+
+    if(x == 0)
+        return 1;
+    return std::pow(std::sin(ratio * x) / (ratio * std::sin(x)), FA_CIC_ORDER);
+}
+
+void decimator::push_back(int32_t value)
+{
+    int64_t sample = value;
+
+    if(!stages[0].push(sample, sample))
+        return;
+    tens.push_back(sample / 1000.0);
+
+    if(!stages[1].push(sample, sample))
+        return;
+    hundreds.push_back(sample / 1000.0);
+
+    if(!stages[2].push(sample, sample))
+        return;
+    thousands.push_back(sample / 1000.0);
+}
+
+void decimator::clear()
+{
+    for(int i = 0; i < FA_DECIMATOR_LEVELS; i++)
+        stages[i].clear();
+    tens.clear();
+    hundreds.clear();
+    thousands.clear();
+}
+
+int decimator::level(int ratio)
+{
+    return ratio >= 1000 ? 2 : ratio >= 100 ? 1 : 0;
+}
+
+size_t decimator::size(int ratio) const
+{
+    int i = level(ratio);
+    return i == 0 ? tens.size() : i == 1 ? hundreds.size() : thousands.size();
+}
+
+void decimator::read(int ratio, float* out, size_t count) const
+{
+    int i = level(ratio);
+    const float* data = i == 0 ? tens.data() : i == 1 ? hundreds.data() : thousands.data();
+    size_t available = std::min(count, size(ratio));
+    size_t missing = count - available;
+
+    std::fill(out, out + missing, 0);
+    std::copy(data + size(ratio) - available, data + size(ratio), out + missing);
+}
+
+zoom::zoom() : phasor(1), rotation(1), factor(0), turns(0)
+{
+}
+
+int zoom::ratio(double low, double high, double rate)
+{
+    if(high <= low)
+        return 0;
+    return std::clamp<int>(FA_ZOOM_BAND * rate / (high - low), 1, FA_ZOOM_RATIO);
+}
+
+void zoom::tune(double centre, int ratio, double rate)
+{
+    factor = ratio;
+    phasor = 1;
+    turns = 0;
+    rotation = std::polar(1.0, -2 * M_PI * centre / rate);
+    for(int i = 0; i < 4; i++)
+        stages[i] = cic(std::max(1, ratio));
+    clear();
+}
+
+void zoom::push_back(int32_t x, int32_t y)
+{
+    double value;
+
+    if(factor == 0)
+        return;
+
+    int64_t mixed[4] = {std::llround(x * phasor.real()), std::llround(x * phasor.imag()),
+                        std::llround(y * phasor.real()), std::llround(y * phasor.imag())};
+
+    //
+    // The oscillator is a running product, renormalised now and then so its
+    // magnitude does not creep away from one.
+    //
+    phasor *= rotation;
+    if(++turns == FA_ZOOM_LENGTH) {
+        turns = 0;
+        phasor /= std::abs(phasor);
+    }
+
+    // The four stages run in lock step.
+    for(int i = 0; i < 4; i++) {
+        if(stages[i].push(mixed[i], value))
+            rings[i].push_back(value / 1000.0);
+    }
+}
+
+void zoom::clear()
+{
+    for(int i = 0; i < 4; i++) {
+        stages[i].clear();
+        rings[i].clear();
+    }
+}
+
+void zoom::read(int trace, float* out) const
+{
+    for(int i = 0; i < 2; i++) {
+        const buffer<float, FA_ZOOM_LENGTH>& ring = rings[2 * trace + i];
+        size_t missing = FA_ZOOM_LENGTH - ring.size();
+
+        std::fill(out, out + missing, 0);
+        std::copy(ring.data(), ring.data() + ring.size(), out + missing);
+        out += FA_ZOOM_LENGTH;
+    }
+}
+
+}
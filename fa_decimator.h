@@ -0,0 +1,122 @@
+#ifndef FA_DECIMATOR_H
+#define FA_DECIMATOR_H
+
+#include <complex>
+#include <cstdint>
+#include <cstddef>
+
+#include <fa_tools.h>
+
+#define FA_CIC_ORDER        3
+#define FA_CIC_RATIO        10
+#define FA_DECIMATOR_LEVELS 3
+#define FA_DECIMATED_SIZE   500000
+#define FA_ZOOM_LENGTH      4096
+#define FA_ZOOM_RATIO       1000
+#define FA_ZOOM_BAND        0.5
+
+namespace fa
+{
+
+//
+// Third order CIC filter decimating by 10 (or `ratio`, up to FA_ZOOM_RATIO
+// so the R^3 gain still fits the registers). The integrators run on every
+// input sample and the combs on every tenth, in unsigned 64-bit integers
+// that are allowed to wrap (the combs undo it), so the filter is exact and
+// never drifts. Its sinc^3
+// response rejects what would alias onto the first output decade by more
+// than 40 dB.
+//
+class cic
+{
+public:
+    explicit cic(int ratio = FA_CIC_RATIO);
+
+    // True when `value` completed an output sample, stored in `out` (same
+    // units as the input, rounded or exact).
+    bool push(int64_t value, int64_t& out);
+    bool push(int64_t value, double& out);
+    void clear();
+
+    // Amplitude response at `frequency` for an input sampled at `rate`.
+    static double response(double frequency, double rate, int ratio = FA_CIC_RATIO);
+
+private:
+    bool step(int64_t value, int64_t& sum);
+
+    uint64_t integrator[FA_CIC_ORDER];
+    uint64_t comb[FA_CIC_ORDER];
+    int phase;
+    int ratio;
+    int64_t gain;
+};
+
+//
+// Cascade of three CIC stages maintaining 10:1, 100:1 and 1000:1 rings (um)
+// next to the full-rate one. Each input sample costs one pass through the
+// first stage, so the decimated views are kept up to date in O(new samples).
+// The 10:1 ring holds FA_DECIMATED_SIZE samples and each deeper one a tenth
+// of the one above, the same span, since that is all a window can ask for.
+//
+class decimator
+{
+public:
+    void push_back(int32_t value);
+    void clear();
+
+    // Ratio is one of 10, 100 or 1000.
+    size_t size(int ratio) const;
+
+    // The newest `count` samples of that ring, zero where it has not filled.
+    void read(int ratio, float* out, size_t count) const;
+
+    static int level(int ratio);
+
+private:
+    cic stages[FA_DECIMATOR_LEVELS];
+    buffer<float, FA_DECIMATED_SIZE> tens;
+    buffer<float, FA_DECIMATED_SIZE / 10> hundreds;
+    buffer<float, FA_DECIMATED_SIZE / 100> thousands;
+};
+
+//
+// Band (zoom) decimator. Both traces are mixed down by `centre` with a
+// complex oscillator, rounded back to integer nm and decimated by a CIC
+// pair, which leaves the band around `centre` as complex baseband samples
+// at rate / ratio. Only the newest FA_ZOOM_LENGTH of them are kept, so the
+// band spectrum is one short complex FFT whose bins are ratio times finer
+// than those of a full-rate FFT of the same length.
+//
+class zoom
+{
+public:
+    zoom();
+
+    // Smallest output rate that keeps [low, high] within FA_ZOOM_BAND of
+    // it, where the sinc^3 rejects aliases by 30 dB or more.
+    static int ratio(double low, double high, double rate);
+
+    // A zero ratio stops the mixer. The rings and the oscillator restart.
+    void tune(double centre, int ratio, double rate);
+    bool tuned() const { return factor > 0; }
+
+    void push_back(int32_t x, int32_t y);
+    void clear();
+    size_t size() const { return rings[0].size(); }
+
+    // In-phase then quadrature samples (um) of trace 0 (x) or 1 (y), the
+    // newest FA_ZOOM_LENGTH of each, zero where the ring has not filled.
+    void read(int trace, float* out) const;
+
+private:
+    std::complex<double> phasor;
+    std::complex<double> rotation;
+    int factor;
+    int turns;
+    cic stages[4];
+    buffer<float, FA_ZOOM_LENGTH> rings[4];
+};
+
+}
+
+#endif // FA_DECIMATOR_H
@@ -0,0 +1,119 @@
+#include "fa_heatmap.h"
+#include "fa_tools.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/core/core.hpp>
+
+namespace fa
+{
+
+heatmap::heatmap() : rows(0), length(0), segment(0), rate(0), low(FA_WATERFALL_LOW), high(FA_WATERFALL_HIGH), solved(0)
+{
+}
+
+void heatmap::resize(size_t bpms, size_t length)
+{
+    this->rows = bpms;
+    this->length = length;
+    planes[0].resize(bpms * length);
+    planes[1].resize(bpms * length);
+}
+
+void heatmap::set_range(float low, float high)
+{
+    this->low = low;
+    this->high = std::max(high, low * 1.001f);
+}
+
+void heatmap::layout()
+{
+    size_t bins = segment / 2;
+    double last = bins - 1;
+
+    //
+    // Column c spans bins [last^(c/C), last^((c+1)/C)), at least the one
+    // bin it starts in, so low columns repeat a bin rather than bend the
+    // log scale.
+    //
+    first.resize(FA_HEATMAP_COLUMNS);
+    count.resize(FA_HEATMAP_COLUMNS);
+    edges.resize(FA_HEATMAP_COLUMNS);
+    for(size_t c = 0; c < FA_HEATMAP_COLUMNS; c++) {
+        size_t start = std::pow(last, double(c) / FA_HEATMAP_COLUMNS);
+        size_t stop = std::pow(last, double(c + 1) / FA_HEATMAP_COLUMNS);
+        first[c] = start;
+        count[c] = std::max<size_t>(1, stop - std::min(stop, start));
+        edges[c] = std::pow(last, double(c) / FA_HEATMAP_COLUMNS) * rate / segment;
+    }
+
+    if(taper.size() != segment) {
+        float delta = (M_PI - -M_PI) / (segment - 1);
+        taper.resize(segment);
+        for(size_t i = 0; i < segment; i++)
+            taper[i] = 1 + cos(-M_PI + delta * i);
+    }
+}
+
+void heatmap::solve(float rate)
+{
+    size_t segments = FA_HEATMAP_SEGMENTS;
+    size_t hop;
+    size_t columns = FA_HEATMAP_COLUMNS;
+    float norm;
+
+    if(rows == 0 || 2 * length / (segments + 1) < 8)
+        return;
+
+    if(rate != this->rate || 2 * length / (segments + 1) != segment) {
+        this->rate = rate;
+        segment = 2 * length / (segments + 1);
+        layout();
+    }
+    hop = segment / 2;
+    norm = 2 / (rate * segment) / segments;
+
+    batch.resize(rows * 2 * segments * segment);
+    amplitudes[0].resize(rows * columns);
+    amplitudes[1].resize(rows * columns);
+    pixels[0].resize(rows * columns);
+    pixels[1].resize(rows * columns);
+
+    FA_UNCOUNTED;
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+        for(int bpm = range.start; bpm < range.end; bpm++) {
+            float* block = batch.data() + bpm * 2 * segments * segment;
+            cv::Mat matrix(2 * segments, segment, CV_32F, block);
+
+            for(size_t r = 0; r < 2 * segments; r++) {
+                const float* source = planes[r / segments].data() + bpm * length + (r % segments) * hop;
+                float* row = block + r * segment;
+                for(size_t i = 0; i < segment; i++)
+                    row[i] = source[i] * taper[i];
+            }
+            cv::dft(matrix, matrix, cv::DFT_ROWS);
+
+            // Mean power of the bins under each column, averaged over the segments.
+            for(int axis = 0; axis < 2; axis++) {
+                const float* spectra = block + axis * segments * segment;
+                float* out = amplitudes[axis].data() + bpm * columns;
+                for(size_t c = 0; c < columns; c++) {
+                    double sum = 0;
+                    for(size_t s = 0; s < segments; s++) {
+                        const float* row = spectra + s * segment;
+                        for(size_t b = first[c]; b < first[c] + count[c]; b++)
+                            sum += row[2 * b - 1] * row[2 * b - 1] + row[2 * b] * row[2 * b];
+                    }
+                    out[c] = std::sqrt(sum * norm / count[c]);
+                }
+            }
+        }
+    });
+
+    colours.map(amplitudes[0].data(), rows * columns, low, high, pixels[0].data());
+    colours.map(amplitudes[1].data(), rows * columns, low, high, pixels[1].data());
+    solved++;
+}
+
+}
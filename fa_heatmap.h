@@ -0,0 +1,73 @@
+#ifndef FA_HEATMAP_H
+#define FA_HEATMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <fa_waterfall.h>
+
+#define FA_HEATMAP_COLUMNS  256
+#define FA_HEATMAP_SEGMENTS 4
+
+namespace fa
+{
+
+//
+// Amplitude spectral density of every BPM over a common window, as an
+// image per plane: one row per BPM, FA_HEATMAP_COLUMNS log-spaced columns
+// from the first bin to Nyquist. Each BPM is one worker's job: its Welch
+// segments of both planes are tapered into one matrix, transformed by a
+// single DFT_ROWS call and reduced straight into the columns. The images
+// are then mapped in one palette pass per plane.
+//
+class heatmap
+{
+public:
+    heatmap();
+
+    // Window of `length` samples of `bpms` BPMs. plane(axis) then holds
+    // one row per BPM (um), to be filled before solve().
+    void resize(size_t bpms, size_t length);
+    std::vector<float>& plane(int axis) { return planes[axis]; }
+
+    // Amplitudes (um/sqrt(Hz)) mapped to the ends of the palette.
+    void set_range(float low, float high);
+
+    void solve(float rate);
+
+    bool   ready()   const { return solved > 0; }
+    size_t bpms()    const { return rows; }
+    size_t columns() const { return first.size(); }
+
+    // Lower edge of a column (Hz) and a BPM's amplitude in it.
+    float frequency(size_t column) const { return edges[column]; }
+    float amplitude(int axis, size_t bpm, size_t column) const { return amplitudes[axis][bpm * columns() + column]; }
+
+    // bpms() x columns() RGB32 pixels.
+    const uint32_t* image(int axis) const { return pixels[axis].data(); }
+
+private:
+    void layout();
+
+    std::vector<float> planes[2];
+    std::vector<float> batch;
+    std::vector<float> taper;
+    std::vector<size_t> first;
+    std::vector<size_t> count;
+    std::vector<float> edges;
+    std::vector<float> amplitudes[2];
+    std::vector<uint32_t> pixels[2];
+    palette colours;
+    size_t rows;
+    size_t length;
+    size_t segment;
+    float rate;
+    float low;
+    float high;
+    uint64_t solved;
+};
+
+}
+
+#endif // FA_HEATMAP_H
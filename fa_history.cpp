@@ -0,0 +1,424 @@
+#include "fa_history.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace fa
+{
+
+static inline uint32_t zigzag(int32_t value)
+{
+    return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+}
+
+size_t encode_block(const int32_t* in, uint32_t* out)
+{
+    uint32_t deltas[FA_BLOCK_SAMPLES];
+    uint32_t bits = 0;
+    uint32_t width;
+    uint32_t* words = out + 2;
+
+    for(int i = 0; i < FA_BLOCK_SAMPLES; i++) {
+        uint32_t previous = uint32_t(i < FA_BLOCK_LANES ? in[0] : in[i - FA_BLOCK_LANES]);
+        deltas[i] = zigzag(int32_t(uint32_t(in[i]) - previous));
+        bits |= deltas[i];
+    }
+
+    width = 0;
+    while(width < 32 && (bits >> width) != 0)
+        width++;
+
+    out[0] = uint32_t(in[0]);
+    out[1] = width;
+    memset(words, 0, FA_BLOCK_LANES * width * sizeof(uint32_t));
+
+    for(int j = 0; width > 0 && j < FA_BLOCK_SAMPLES / FA_BLOCK_LANES; j++) {
+        uint32_t bit   = j * width;
+        uint32_t word  = bit >> 5;
+        uint32_t shift = bit & 31;
+        for(int lane = 0; lane < FA_BLOCK_LANES; lane++) {
+            uint32_t value = deltas[j * FA_BLOCK_LANES + lane];
+            words[word * FA_BLOCK_LANES + lane] |= value << shift;
+            if(shift + width > 32)
+                words[(word + 1) * FA_BLOCK_LANES + lane] |= value >> (32 - shift);
+        }
+    }
+
+    return block_words(width);
+}
+
+void decode_block(const uint32_t* in, float* out, float scale)
+{
+    int32_t  seed  = int32_t(in[0]);
+    uint32_t width = in[1];
+    const uint32_t* words = in + 2;
+
+    if(width == 0) {
+        std::fill(out, out + FA_BLOCK_SAMPLES, seed * scale);
+        return;
+    }
+
+#ifdef __SSE2__
+    const __m128i mask = _mm_set1_epi32(width == 32 ? -1 : int((1u << width) - 1));
+    const __m128i one  = _mm_set1_epi32(1);
+    const __m128  factor = _mm_set1_ps(scale);
+    __m128i acc = _mm_set1_epi32(seed);
+
+    for(int j = 0; j < FA_BLOCK_SAMPLES / FA_BLOCK_LANES; j++) {
+        uint32_t bit   = j * width;
+        uint32_t word  = bit >> 5;
+        uint32_t shift = bit & 31;
+        __m128i v = _mm_srl_epi32(_mm_loadu_si128((const __m128i*) (words + word * FA_BLOCK_LANES)), _mm_cvtsi32_si128(shift));
+        if(shift + width > 32) {
+            __m128i spill = _mm_loadu_si128((const __m128i*) (words + (word + 1) * FA_BLOCK_LANES));
+            v = _mm_or_si128(v, _mm_sll_epi32(spill, _mm_cvtsi32_si128(32 - shift)));
+        }
+        v = _mm_and_si128(v, mask);
+        v = _mm_xor_si128(_mm_srli_epi32(v, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(v, one)));
+        acc = _mm_add_epi32(acc, v);
+        _mm_storeu_ps(out + j * FA_BLOCK_LANES, _mm_mul_ps(_mm_cvtepi32_ps(acc), factor));
+    }
+#else
+    uint32_t mask = width == 32 ? ~0u : (1u << width) - 1;
+    uint32_t acc[FA_BLOCK_LANES];
+    std::fill(acc, acc + FA_BLOCK_LANES, uint32_t(seed));
+
+    for(int j = 0; j < FA_BLOCK_SAMPLES / FA_BLOCK_LANES; j++) {
+        uint32_t bit   = j * width;
+        uint32_t word  = bit >> 5;
+        uint32_t shift = bit & 31;
+        for(int lane = 0; lane < FA_BLOCK_LANES; lane++) {
+            uint32_t v = words[word * FA_BLOCK_LANES + lane] >> shift;
+            if(shift + width > 32)
+                v |= words[(word + 1) * FA_BLOCK_LANES + lane] << (32 - shift);
+            v &= mask;
+            acc[lane] += (v >> 1) ^ (0u - (v & 1));
+            out[j * FA_BLOCK_LANES + lane] = int32_t(acc[lane]) * scale;
+        }
+    }
+#endif
+}
+
+int64_t wall_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+segment::segment(const std::string& path, uint64_t first)
+    : path(path), map(nullptr), start(first), used(4), fd(-1), idx(-1)
+{
+    void* memory;
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+        return;
+
+    if(::ftruncate(fd, FA_SEGMENT_SIZE) != 0)
+        return;
+
+    memory = ::mmap(nullptr, FA_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(memory == MAP_FAILED)
+        return;
+
+    map = (uint32_t*) memory;
+    map[0] = FA_SEGMENT_MAGIC;
+    map[1] = FA_BLOCK_SAMPLES;
+    memcpy(map + 2, &first, sizeof(first));
+
+    idx = ::open((path + ".idx").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+}
+
+segment::~segment()
+{
+    if(map) {
+        ::munmap(map, FA_SEGMENT_SIZE);
+        if(::ftruncate(fd, bytes()) != 0)
+            perror(path.c_str());
+    }
+
+    if(fd >= 0)
+        ::close(fd);
+    if(idx >= 0)
+        ::close(idx);
+}
+
+bool segment::append(const uint32_t* block, size_t words, int64_t time)
+{
+    entry item = {end(), time, used};
+
+    if(!map || (used + words) * sizeof(uint32_t) > FA_SEGMENT_SIZE)
+        return false;
+
+    memcpy(map + used, block, words * sizeof(uint32_t));
+    used += words;
+
+    index.push_back(item);
+    if(idx >= 0 && ::write(idx, &item, sizeof(item)) != sizeof(item)) {
+        ::close(idx);
+        idx = -1;
+    }
+
+    return true;
+}
+
+history::history(size_t capacity)
+    : npending(0), first(0), resident(0), total(0), capacity(capacity), nbytes(0), budget(0), retention(0)
+{
+}
+
+void history::push_back(int32_t value)
+{
+    pending[npending++] = value;
+    total++;
+    if(npending == FA_BLOCK_SAMPLES)
+        seal();
+}
+
+void history::clear()
+{
+    blocks.clear();
+    times.clear();
+    segments.clear();
+    npending = 0;
+    first = 0;
+    resident = 0;
+    total = 0;
+    nbytes = 0;
+}
+
+void history::set_capacity(size_t samples)
+{
+    capacity = samples;
+    while(capacity > 0 && !blocks.empty() && total - resident > capacity) {
+        if(!directory.empty())
+            spill(*blocks.front(), times.front());
+
+        nbytes -= blocks.front()->size() * sizeof(uint32_t);
+        blocks.pop_front();
+        times.pop_front();
+        resident += FA_BLOCK_SAMPLES;
+    }
+
+    first = segments.empty() ? resident : segments.front()->first();
+}
+
+void history::set_spill(const std::string& directory, uint64_t budget, int64_t retention)
+{
+    this->directory = directory;
+    this->budget = budget;
+    this->retention = retention;
+
+    if(!directory.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if(error)
+            this->directory.clear();
+    }
+}
+
+void history::set_name(const std::string& name)
+{
+    this->name = name;
+}
+
+void history::seal()
+{
+    uint32_t packed[block_words(32)];
+    size_t words = encode_block(pending, packed);
+
+    blocks.push_back(std::make_shared<const std::vector<uint32_t>>(packed, packed + words));
+    times.push_back(wall_time());
+    nbytes += words * sizeof(uint32_t);
+    npending = 0;
+
+    set_capacity(capacity);
+}
+
+void history::spill(const std::vector<uint32_t>& block, int64_t time)
+{
+    std::error_code error;
+    std::string folder = directory + "/" + name;
+
+    if(!segments.empty() && segments.back()->end() == resident &&
+       segments.back()->append(block.data(), block.size(), time))
+        return;
+
+    std::filesystem::create_directories(folder, error);
+    std::string path = folder + "/" + std::to_string(resident) + "-" + std::to_string(time / 1000000000) + ".seg";
+    segments.emplace_back(new segment(path, resident));
+    if(error || !segments.back()->valid() || !segments.back()->append(block.data(), block.size(), time)) {
+        //
+        // Spilling stops here. What was spilled before would leave a gap
+        // below the blocks still in RAM, so it is dropped too.
+        //
+        segments.clear();
+        directory.clear();
+        return;
+    }
+
+    expire();
+}
+
+void history::expire()
+{
+    namespace fs = std::filesystem;
+
+    struct file { fs::path path; fs::file_time_type time; uint64_t size; };
+    std::vector<file> files;
+    std::error_code error;
+    uint64_t used = 0;
+    fs::path folder = fs::path(directory) / name;
+    auto oldest = fs::file_time_type::clock::now() - std::chrono::seconds(retention);
+
+    // Only this history's own folder counts against its budget.
+    for(auto& item : fs::directory_iterator(folder, error)) {
+        if(item.path().extension() != ".seg")
+            continue;
+        files.push_back({item.path(), item.last_write_time(error), item.file_size(error)});
+        used += files.back().size;
+    }
+
+    std::sort(files.begin(), files.end(), [](const file& a, const file& b) { return a.time < b.time; });
+
+    for(auto& item : files) {
+        if((budget == 0 || used <= budget) && (retention == 0 || item.time >= oldest))
+            break;
+
+        //
+        // Files left from earlier runs go first. Mapped segments only go
+        // from the front, and never the one that is still being written.
+        //
+        bool mapped = std::any_of(segments.begin(), segments.end(),
+                                  [&](const std::shared_ptr<segment>& s) { return item.path == folder / s->name(); });
+        if(item.path == folder / segments.back()->name())
+            break;
+        if(mapped && item.path != folder / segments.front()->name())
+            break;
+        if(mapped)
+            segments.pop_front();
+
+        fs::remove(item.path, error);
+        fs::remove(item.path.string() + ".idx", error);
+        used -= item.size;
+    }
+
+    first = segments.empty() ? resident : segments.front()->first();
+}
+
+const uint32_t* history::find(uint64_t index) const
+{
+    if(index >= resident)
+        return blocks[(index - resident) / FA_BLOCK_SAMPLES]->data();
+
+    auto item = std::upper_bound(segments.begin(), segments.end(), index,
+                                 [](uint64_t value, const std::shared_ptr<segment>& s) { return value < s->end(); });
+    if(item == segments.end() || index < (*item)->first())
+        return nullptr;
+    return (*item)->block((index - (*item)->first()) / FA_BLOCK_SAMPLES);
+}
+
+//
+// [start, start + count) of a sealed run [first, sealed) followed by the
+// unsealed samples up to total, the blocks looked up by `find`.
+//
+template <typename F>
+static void decode_range(uint64_t start, size_t count, float* out, float scale, uint64_t first, uint64_t sealed,
+                         uint64_t total, const int32_t* pending, F find)
+{
+    float scratch[FA_BLOCK_SAMPLES];
+    uint64_t stop = start + count;
+    uint64_t index = start;
+
+    if(index < first) {
+        size_t missing = std::min<uint64_t>(first - index, count);
+        std::fill(out, out + missing, 0.0f);
+        index += missing;
+    }
+
+    while(index < stop && index < sealed) {
+        size_t offset = index % FA_BLOCK_SAMPLES;
+        size_t length = std::min<uint64_t>(FA_BLOCK_SAMPLES - offset, stop - index);
+        float* target = out + (index - start);
+        const uint32_t* block = find(index);
+
+        if(!block) {
+            std::fill(target, target + length, 0.0f);
+        }
+        else if(offset == 0 && length == FA_BLOCK_SAMPLES) {
+            decode_block(block, target, scale);
+        }
+        else {
+            decode_block(block, scratch, scale);
+            std::copy(scratch + offset, scratch + offset + length, target);
+        }
+        index += length;
+    }
+
+    for(; index < stop && index < total; index++)
+        out[index - start] = pending[index - sealed] * scale;
+
+    if(index < stop)
+        std::fill(out + (index - start), out + count, 0.0f);
+}
+
+void history::decode(uint64_t start, size_t count, float* out, float scale) const
+{
+    decode_range(start, count, out, scale, first, total - npending, total, pending,
+                 [this](uint64_t index) { return find(index); });
+}
+
+history_view history::view(uint64_t start) const
+{
+    history_view out;
+    uint64_t sealed = total - npending;
+    uint64_t index = std::max(start, first) / FA_BLOCK_SAMPLES * FA_BLOCK_SAMPLES;
+
+    out.first = std::min(index, sealed);
+    out.total = total;
+    out.pending.assign(pending, pending + npending);
+
+    //
+    // Segments are shared whole: one that is still being appended to only
+    // grows past the blocks taken here.
+    //
+    for(auto& item : segments) {
+        if(item->end() <= index)
+            continue;
+        for(; index < item->end(); index += FA_BLOCK_SAMPLES)
+            out.blocks.push_back(item->block((index - item->first()) / FA_BLOCK_SAMPLES));
+        out.owners.push_back(item);
+    }
+
+    for(; index < sealed; index += FA_BLOCK_SAMPLES) {
+        auto& block = blocks[(index - resident) / FA_BLOCK_SAMPLES];
+        out.blocks.push_back(block->data());
+        out.owners.push_back(block);
+    }
+
+    return out;
+}
+
+history_view::history_view() : first(0), total(0)
+{
+}
+
+void history_view::decode(uint64_t start, size_t count, float* out, float scale) const
+{
+    decode_range(start, count, out, scale, first, first + blocks.size() * FA_BLOCK_SAMPLES, total, pending.data(),
+                 [this](uint64_t index) { return blocks[(index - first) / FA_BLOCK_SAMPLES]; });
+}
+
+}
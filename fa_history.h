@@ -0,0 +1,159 @@
+#ifndef FA_HISTORY_H
+#define FA_HISTORY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define FA_BLOCK_SAMPLES    128
+#define FA_BLOCK_LANES      4
+#define FA_SEGMENT_SIZE     (64 << 20)
+#define FA_SEGMENT_MAGIC    0x47535046  // "FPSG"
+
+namespace fa
+{
+
+//
+// Compressed block layout (all uint32_t):
+//  [0]    seed, the first sample of the block
+//  [1]    bit width of the packed values
+//  [2..]  4 * width words, the 128 samples split over 4 interleaved lanes
+//
+// Sample i belongs to lane i % 4 and is stored as the zigzag-encoded delta to
+// sample i - 4, so the four lanes unpack and integrate in lockstep in one SIMD
+// register.
+//
+size_t encode_block(const int32_t* in, uint32_t* out);
+void   decode_block(const uint32_t* in, float* out, float scale);
+
+constexpr size_t block_words(uint32_t width) { return 2 + FA_BLOCK_LANES * width; }
+
+int64_t wall_time();
+
+//
+// Append-only, memory-mapped file of compressed blocks. Blocks are written
+// back to back after a small header; the time index (sample, wall time and
+// offset of every block) goes to a sidecar ".idx" file and stays in memory
+// for lookups. Reads go through the mapping, so the page cache decides what
+// is resident.
+//
+class segment
+{
+public:
+    struct entry
+    {
+        uint64_t sample;
+        int64_t  time;
+        uint64_t offset;
+    };
+
+    segment(const std::string& path, uint64_t first);
+    ~segment();
+
+    bool valid() const { return map != nullptr; }
+    bool append(const uint32_t* block, size_t words, int64_t time);
+
+    const uint32_t* block(size_t n) const { return map + index[n].offset; }
+    size_t   blocks() const { return index.size(); }
+    uint64_t first()  const { return start; }
+    uint64_t end()    const { return start + index.size() * FA_BLOCK_SAMPLES; }
+    size_t   bytes()  const { return used * sizeof(uint32_t); }
+    std::string name() const { return path.substr(path.find_last_of('/') + 1); }
+
+private:
+    std::string path;
+    std::vector<entry> index;
+    uint32_t* map;
+    uint64_t start;
+    size_t used;
+    int fd;
+    int idx;
+};
+
+//
+// Read-only view of a history as it was when taken. It shares the sealed
+// blocks, in RAM or mapped from disk, which never change, and copies the
+// few samples not sealed yet, so it can be decoded on another thread while
+// the history goes on filling.
+//
+class history_view
+{
+public:
+    history_view();
+
+    uint64_t begin() const { return first; }
+    uint64_t end()   const { return total; }
+
+    // As history::decode().
+    void decode(uint64_t start, size_t count, float* out, float scale) const;
+
+private:
+    friend class history;
+
+    std::vector<const uint32_t*> blocks;
+    std::vector<std::shared_ptr<const void>> owners;
+    std::vector<int32_t> pending;
+    uint64_t first;
+    uint64_t total;
+};
+
+class history
+{
+public:
+    explicit history(size_t capacity = 0);
+
+    void push_back(int32_t value);
+    void clear();
+
+    // Keep at most this many samples in RAM, 0 keeps everything.
+    void set_capacity(size_t samples);
+
+    // Blocks aged out of RAM are appended to segment files named
+    // <directory>/<name>/<first sample>-<time>.seg. Files in that folder
+    // beyond the byte budget or older than the retention (seconds) are
+    // deleted; other histories' folders are never touched. An empty
+    // directory disables spilling.
+    void set_spill(const std::string& directory, uint64_t budget, int64_t retention);
+    void set_name(const std::string& name);
+
+    // Absolute sample indexes: [begin(), end()) is what can still be decoded.
+    uint64_t begin() const { return first; }
+    uint64_t end()   const { return total; }
+    size_t   bytes() const { return nbytes; }
+
+    // Decodes [start, start + count) scaled by `scale` straight into out.
+    // Samples that are no longer (or not yet) retained are written as zero.
+    void decode(uint64_t start, size_t count, float* out, float scale) const;
+
+    // Everything from `start` on, in O(blocks) without decoding.
+    history_view view(uint64_t start) const;
+
+private:
+    void seal();
+    void spill(const std::vector<uint32_t>& block, int64_t time);
+    void expire();
+    const uint32_t* find(uint64_t index) const;
+
+    std::deque<std::shared_ptr<const std::vector<uint32_t>>> blocks;
+    std::deque<int64_t> times;
+    std::deque<std::shared_ptr<segment>> segments;
+    int32_t  pending[FA_BLOCK_SAMPLES];
+    size_t   npending;
+    uint64_t first;
+    uint64_t resident;
+    uint64_t total;
+    size_t   capacity;
+    size_t   nbytes;
+
+    std::string directory;
+    std::string name;
+    uint64_t budget;
+    int64_t  retention;
+};
+
+}
+
+#endif // FA_HISTORY_H
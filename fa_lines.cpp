@@ -0,0 +1,84 @@
+#include "fa_lines.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace fa
+{
+
+line_monitor::line_monitor() : frequency(0), position(0), completed(0)
+{
+}
+
+void line_monitor::configure(const std::vector<float>& frequencies, float rate, size_t length)
+{
+    frequency = rate;
+    coefficients.resize(frequencies.size());
+    for(size_t i = 0; i < frequencies.size(); i++)
+        coefficients[i] = 2 * std::cos(2 * M_PI * frequencies[i] / rate);
+
+    taper.resize(length);
+    for(size_t i = 0; i < length; i++)
+        taper[i] = 1 - std::cos(2 * M_PI * i / length);
+
+    amplitudes.assign(2 * frequencies.size(), 0);
+    clear();
+}
+
+void line_monitor::clear()
+{
+    state.assign(4 * coefficients.size(), 0);
+    position = 0;
+    completed = 0;
+}
+
+void line_monitor::push(const int32_t* samples, size_t count)
+{
+    size_t lines = coefficients.size();
+    size_t length = taper.size();
+
+    if(lines == 0 || length == 0)
+        return;
+
+    for(size_t n = 0; n < count; n++) {
+        double x = samples[2 * n] * taper[position];
+        double y = samples[2 * n + 1] * taper[position];
+
+        //
+        // state holds s[n - 1] and s[n - 2] of the X then Y resonator of
+        // every line.
+        //
+        for(size_t i = 0; i < lines; i++) {
+            double* s = &state[4 * i];
+            double c = coefficients[i];
+            double sx = x + c * s[0] - s[1];
+            double sy = y + c * s[2] - s[3];
+            s[1] = s[0];
+            s[0] = sx;
+            s[3] = s[2];
+            s[2] = sy;
+        }
+
+        if(++position < length)
+            continue;
+
+        //
+        // |X(w)|^2 from the last two states, then the peak 2|X| / length
+        // (the taper has unit mean) as an rms amplitude in um.
+        //
+        for(size_t i = 0; i < lines; i++) {
+            double* s = &state[4 * i];
+            double c = coefficients[i];
+            double power_x = s[0] * s[0] + s[1] * s[1] - c * s[0] * s[1];
+            double power_y = s[2] * s[2] + s[3] * s[3] - c * s[2] * s[3];
+            amplitudes[2 * i] = std::sqrt(2 * std::max(0.0, power_x)) / length / 1000;
+            amplitudes[2 * i + 1] = std::sqrt(2 * std::max(0.0, power_y)) / length / 1000;
+            s[0] = s[1] = s[2] = s[3] = 0;
+        }
+
+        position = 0;
+        completed++;
+    }
+}
+
+}
@@ -0,0 +1,50 @@
+#ifndef FA_LINES_H
+#define FA_LINES_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace fa
+{
+
+//
+// Amplitudes of a few fixed lines (mains harmonics, RF leaks) of one BPM,
+// from one Goertzel resonator per line and axis. Every sample costs two
+// multiply-adds per line, whatever the block length. The samples are
+// tapered (1 - cos, unit mean) and the resonators are read out and restarted
+// every `length` samples, so rounding cannot pile up the way it does in a
+// sliding DFT. The readout is the rms amplitude (um) of a sine at exactly
+// that frequency.
+//
+class line_monitor
+{
+public:
+    line_monitor();
+
+    void configure(const std::vector<float>& frequencies, float rate, size_t length);
+    void clear();
+
+    // `count` interleaved X/Y pairs (nm).
+    void push(const int32_t* samples, size_t count);
+
+    size_t lines() const { return coefficients.size(); }
+    float  rate()  const { return frequency; }
+
+    // Last complete block, `axis` 0 for X and 1 for Y.
+    float amplitude(size_t line, int axis) const { return amplitudes[2 * line + axis]; }
+    uint64_t blocks() const { return completed; }
+
+private:
+    std::vector<double> coefficients;
+    std::vector<double> state;
+    std::vector<float> taper;
+    std::vector<float> amplitudes;
+    float frequency;
+    size_t position;
+    uint64_t completed;
+};
+
+}
+
+#endif // FA_LINES_H
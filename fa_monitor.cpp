@@ -0,0 +1,469 @@
+#include "fa_monitor.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <limits>
+
+FaMonitor::FaMonitor(const QJsonObject& config, FaAcquisition* acquisition, QObject *parent)
+    : QObject(parent),
+      acquisition(acquisition),
+      statistics(false),
+      orbiting(false),
+      orbitSolved(false),
+      crossing(false),
+      crossSolved(false),
+      mapping(false),
+      mapSolved(false),
+      blocks(0),
+      idle(false),
+      cost(0)
+{
+    for(auto item : config.value("monitor_lines").toArray())
+        this->lines.push_back(item.toDouble());
+
+    this->time = config.value("monitor_time").toDouble(FA_MONITOR_TIME);
+    this->limit = config.value("monitor_threshold").toDouble(FA_MONITOR_THRESHOLD);
+    this->window = config.value("stats_time").toDouble(FA_STATS_TIME);
+    this->low = config.value("stats_band").toArray().at(0).toDouble(FA_STATS_LOW);
+    this->high = config.value("stats_band").toArray().at(1).toDouble(FA_STATS_HIGH);
+    this->span = config.value("orbit_time").toDouble(FA_ORBIT_TIME);
+    this->period = config.value("orbit_period").toDouble(FA_ORBIT_PERIOD);
+    this->rank = qMax(1, config.value("orbit_modes").toInt(FA_ORBIT_MODES));
+    this->crossSpan = config.value("coherence_time").toDouble(FA_COHERENCE_TIME);
+    this->crossLow = config.value("coherence_band").toArray().at(0).toDouble(FA_COHERENCE_LOW);
+    this->crossHigh = config.value("coherence_band").toArray().at(1).toDouble(FA_COHERENCE_HIGH);
+    this->mapSpan = config.value("heatmap_time").toDouble(FA_HEATMAP_TIME);
+
+    QString condition = config.value("trigger_condition").toString();
+    this->condition = condition == "threshold" ? TRIGGER_THRESHOLD :
+                      condition == "derivative" ? TRIGGER_DERIVATIVE :
+                      condition == "band_rms" ? TRIGGER_BAND_RMS : TRIGGER_OFF;
+    this->level = config.value("trigger_level").toDouble(FA_TRIGGER_LEVEL);
+    this->triggerLow = config.value("trigger_band").toArray().at(0).toDouble(FA_TRIGGER_LOW);
+    this->triggerHigh = config.value("trigger_band").toArray().at(1).toDouble(FA_TRIGGER_HIGH);
+    this->pre = config.value("trigger_pre").toDouble(FA_TRIGGER_PRE);
+    this->post = config.value("trigger_post").toDouble(FA_TRIGGER_POST);
+    this->holdoff = config.value("trigger_holdoff").toDouble(FA_TRIGGER_HOLDOFF);
+    this->path = config.value("trigger_path").toString(".");
+    if(armed())
+        QDir().mkpath(this->path);
+    this->spectra.set_range(config.value("waterfall_range").toArray().at(0).toDouble(FA_WATERFALL_LOW),
+                            config.value("waterfall_range").toArray().at(1).toDouble(FA_WATERFALL_HIGH));
+    this->nextSpectra.set_range(config.value("waterfall_range").toArray().at(0).toDouble(FA_WATERFALL_LOW),
+                                config.value("waterfall_range").toArray().at(1).toDouble(FA_WATERFALL_HIGH));
+
+    this->timer = new QTimer(this);
+    this->timer->setInterval(FA_MONITOR_PERIOD);
+    QObject::connect(this->timer, &QTimer::timeout, this, &FaMonitor::poll);
+
+    this->watcher = new QFutureWatcher<void>(this);
+    QObject::connect(this->watcher, &QFutureWatcher<void>::finished, this, &FaMonitor::onDrained);
+
+    this->solver = new QFutureWatcher<void>(this);
+    QObject::connect(this->solver, &QFutureWatcher<void>::finished, this, &FaMonitor::onSolved);
+}
+
+FaMonitor::~FaMonitor()
+{
+    this->watcher->waitForFinished();
+    this->solver->waitForFinished();
+}
+
+QList<int> FaMonitor::ids() const
+{
+    QList<int> ids;
+    for(auto& c : this->channels)
+        ids.push_back(c->id);
+    return ids;
+}
+
+void FaMonitor::setStatistics(bool enabled)
+{
+    if(enabled == this->statistics)
+        return;
+
+    // The workers own the channels while a batch runs.
+    this->watcher->waitForFinished();
+    this->statistics = enabled;
+    for(auto& c : this->channels)
+        c->stats.configure(0, 0, this->low, this->high);
+
+    if(active())
+        start();
+    else
+        stop();
+}
+
+void FaMonitor::setOrbit(bool enabled)
+{
+    if(enabled == this->orbiting)
+        return;
+
+    this->orbiting = enabled;
+    this->solved.invalidate();
+
+    if(active())
+        start();
+    else
+        stop();
+}
+
+void FaMonitor::setCoherence(bool enabled)
+{
+    if(enabled == this->crossing)
+        return;
+
+    this->crossing = enabled;
+    this->crossed.invalidate();
+
+    if(active())
+        start();
+    else
+        stop();
+}
+
+void FaMonitor::setHeatmap(bool enabled)
+{
+    if(enabled == this->mapping)
+        return;
+
+    this->mapping = enabled;
+    this->mapped.invalidate();
+
+    if(active())
+        start();
+    else
+        stop();
+}
+
+void FaMonitor::start()
+{
+    if(!active() || this->timer->isActive())
+        return;
+
+    this->watcher->waitForFinished();
+    this->solver->waitForFinished();
+    this->channels.clear();
+    for(int id : this->acquisition->configuredIDs()) {
+        std::unique_ptr<channel> c(new channel);
+        c->id = id;
+        c->source = c->shared.attach(this->acquisition->sharedName(id)) ? &c->shared : this->acquisition->bus(id);
+        c->sequence = c->source ? c->source->sequence() : 0;
+        c->capturing = false;
+        std::fill(&c->values[0][0], &c->values[0][0] + 2 * STATS_COUNT, 0.0f);
+        this->channels.push_back(std::move(c));
+    }
+
+    this->timer->start();
+}
+
+void FaMonitor::stop()
+{
+    this->timer->stop();
+    this->watcher->waitForFinished();
+    this->solver->waitForFinished();
+}
+
+void FaMonitor::poll()
+{
+    //
+    // The ring-wide solves run next to the drain, on a worker of their own,
+    // when they are due and the previous ones have finished.
+    //
+    if(!this->idle && !this->solver->isRunning()) {
+        bool orbit = this->orbiting && (!this->solved.isValid() || this->solved.elapsed() >= this->period * 1000);
+        bool coherence = this->crossing && (!this->crossed.isValid() || this->crossed.elapsed() >= FA_COHERENCE_PERIOD * 1000);
+        bool heatmap = this->mapping && (!this->mapped.isValid() || this->mapped.elapsed() >= FA_HEATMAP_PERIOD * 1000);
+
+        if(orbit)
+            this->solved.start();
+        if(coherence)
+            this->crossed.start();
+        if(heatmap)
+            this->mapped.start();
+        if(orbit || coherence || heatmap) {
+            this->solver->setFuture(QtConcurrent::run([this, orbit, coherence, heatmap]() {
+                this->orbitSolved = orbit && solveOrbit();
+                this->crossSolved = coherence && solveCoherence();
+                this->mapSolved = heatmap && solveHeatmap();
+            }));
+        }
+    }
+
+    if(this->watcher->isRunning())
+        return;
+
+    //
+    // Each worker drains one BPM's bus into its monitors and trigger,
+    // (re)configuring them once the stream's sampling frequency is known.
+    //
+    this->watcher->setFuture(QtConcurrent::map(this->channels, [this](std::unique_ptr<channel>& c) {
+        const int32_t* samples;
+        size_t count;
+
+        if(!c->source || c->source->frequency() <= 0)
+            return;
+
+        if(c->monitor.rate() != c->source->frequency())
+            c->monitor.configure(this->lines, c->source->frequency(), std::max<size_t>(1, this->time * c->source->frequency()));
+        if(this->statistics && c->stats.rate() != c->source->frequency())
+            c->stats.configure(c->source->frequency(), std::max<size_t>(2, this->window * c->source->frequency()), this->low, this->high);
+        if(armed() && c->trigger.rate() != c->source->frequency())
+            c->trigger.configure(this->condition, this->level, this->triggerLow, this->triggerHigh, c->source->frequency(),
+                                 this->holdoff * c->source->frequency());
+
+        samples = c->source->fetch(c->sequence, count);
+        c->monitor.push(samples, count);
+        if(this->statistics)
+            c->stats.push(samples, count);
+
+        uint64_t fired;
+        if(armed() && c->trigger.push(samples, count, c->sequence - count, fired) && !c->capturing) {
+            float rate = c->source->frequency();
+
+            // Both sides fit in what fetch() can still reach once the post-trigger samples are in.
+            size_t before = std::min<uint64_t>(std::min<size_t>(this->pre * rate, FA_BUS_SAMPLES / 6), fired);
+            size_t after = std::min<size_t>(this->post * rate, FA_BUS_SAMPLES / 6);
+            c->event = {c->id, this->condition, c->trigger.axis(), c->trigger.value(), rate, uint32_t(before + after),
+                        fired, fired - before, c->source->time_at(fired)};
+            c->capturing = true;
+        }
+    }));
+}
+
+double FaMonitor::takeCost()
+{
+    double cost = this->cost;
+    this->cost = 0;
+    return cost;
+}
+
+void FaMonitor::onDrained()
+{
+    QElapsedTimer clock;
+    uint64_t blocks = 0;
+
+    clock.start();
+
+    for(auto& c : this->channels) {
+        blocks += c->monitor.blocks() + c->stats.blocks();
+        c->amplitudes.resize(2 * c->monitor.lines());
+        for(size_t line = 0; line < c->monitor.lines(); line++) {
+            c->amplitudes[2 * line] = c->monitor.amplitude(line, 0);
+            c->amplitudes[2 * line + 1] = c->monitor.amplitude(line, 1);
+        }
+        for(int statistic = 0; statistic < STATS_COUNT; statistic++) {
+            c->values[statistic][0] = c->stats.value(statistic, 0);
+            c->values[statistic][1] = c->stats.value(statistic, 1);
+        }
+    }
+
+    if(armed())
+        capture();
+
+    if(blocks != this->blocks) {
+        this->blocks = blocks;
+        emit updated();
+    }
+    this->cost += clock.nsecsElapsed() / 1e6;
+}
+
+void FaMonitor::onSolved()
+{
+    QElapsedTimer clock;
+
+    clock.start();
+    if(this->orbitSolved)
+        std::swap(this->modes, this->nextModes);
+    if(this->crossSolved)
+        std::swap(this->cross, this->nextCross);
+    if(this->mapSolved) {
+        std::swap(this->spectra, this->nextSpectra);
+        emit heatmapUpdated();
+    }
+    this->cost += clock.nsecsElapsed() / 1e6;
+}
+
+void FaMonitor::capture()
+{
+    //
+    // An event is complete once its last sample is on the bus. Its window
+    // is read back from the ring, leaving the live path alone, and copied
+    // once for a worker to compress and write.
+    //
+    for(auto& c : this->channels) {
+        if(!c->capturing || c->source->sequence() < c->event.first + c->event.count)
+            continue;
+
+        uint64_t last = c->event.first;
+        size_t count = 0;
+        const int32_t* samples = c->source->fetch(last, count);
+        c->capturing = false;
+        if(last - count != c->event.first || count < c->event.count)
+            continue;
+
+        fa::event header = c->event;
+        std::shared_ptr<std::vector<int32_t>> window(new std::vector<int32_t>(samples, samples + 2 * header.count));
+        QString name = QString("%1/event-%2-%3.evt").arg(this->path).arg(header.id)
+                           .arg(QDateTime::fromMSecsSinceEpoch(header.time / 1000000).toString("yyyyMMdd-hhmmss.zzz"));
+        auto watcher = new QFutureWatcher<bool>(this);
+
+        QObject::connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, header, name]() {
+            emit captured(header.id, name, watcher->result());
+            watcher->deleteLater();
+        });
+        watcher->setFuture(QtConcurrent::run([name, header, window]() {
+            return fa::save_event(name.toStdString(), header, window->data());
+        }));
+    }
+}
+
+bool FaMonitor::align(int64_t& time, float& rate) const
+{
+    time = std::numeric_limits<int64_t>::max();
+    rate = 0;
+
+    //
+    // A window ends at the newest instant every streaming BPM has reached,
+    // so rows fed by different servers line up.
+    //
+    for(auto& c : this->channels) {
+        if(c->source && c->source->frequency() > 0) {
+            time = std::min(time, c->source->time_at(c->source->sequence()));
+            rate = c->source->frequency();
+        }
+    }
+    return rate > 0;
+}
+
+void FaMonitor::gather(int64_t time, size_t length, float* x, float* y) const
+{
+    // BPMs without enough samples yet contribute a zero row.
+    for(size_t row = 0; row < this->channels.size(); row++, x += length, y += length) {
+        channel& c = *this->channels[row];
+        uint64_t end = c.source && c.source->frequency() > 0 ? c.source->sequence_at(time) : 0;
+        uint64_t last = end - std::min<uint64_t>(end, length);
+        size_t count = 0;
+        const int32_t* samples = end >= length ? c.source->fetch(last, count) : nullptr;
+
+        // fetch() moves a start that is too far behind, the row is then left out.
+        if(!samples || last - count != end - length) {
+            std::fill(x, x + length, 0);
+            std::fill(y, y + length, 0);
+            continue;
+        }
+
+        for(size_t t = 0; t < length; t++) {
+            x[t] = samples[2 * t] / 1000.0;
+            y[t] = samples[2 * t + 1] / 1000.0;
+        }
+    }
+}
+
+bool FaMonitor::solveOrbit()
+{
+    int64_t time;
+    float rate;
+    size_t length;
+
+    if(!align(time, rate))
+        return false;
+
+    length = qBound<size_t>(2, this->span * rate, FA_BUS_SAMPLES / 2);
+    this->nextModes.resize(this->channels.size(), length);
+    gather(time, length, this->nextModes.plane(0).data(), this->nextModes.plane(1).data());
+
+    this->nextModes.solve(rate, this->rank);
+    return true;
+}
+
+bool FaMonitor::solveCoherence()
+{
+    int64_t time;
+    float rate;
+    size_t length;
+
+    if(!align(time, rate))
+        return false;
+
+    length = qBound<size_t>(2, this->crossSpan * rate, FA_BUS_SAMPLES / 2);
+    this->nextCross.resize(this->channels.size(), length);
+    gather(time, length, this->nextCross.plane(0).data(), this->nextCross.plane(1).data());
+
+    this->nextCross.solve(rate);
+    return true;
+}
+
+bool FaMonitor::solveHeatmap()
+{
+    int64_t time;
+    float rate;
+    size_t length;
+
+    if(!align(time, rate))
+        return false;
+
+    length = qBound<size_t>(2, this->mapSpan * rate, FA_BUS_SAMPLES / 2);
+    this->nextSpectra.resize(this->channels.size(), length);
+    gather(time, length, this->nextSpectra.plane(0).data(), this->nextSpectra.plane(1).data());
+
+    this->nextSpectra.solve(rate);
+    return true;
+}
+
+const FaMonitor::channel* FaMonitor::find(int id) const
+{
+    for(auto& c : this->channels) {
+        if(c->id == id)
+            return c.get();
+    }
+    return nullptr;
+}
+
+int FaMonitor::row(int id) const
+{
+    for(size_t row = 0; row < this->channels.size(); row++) {
+        if(this->channels[row]->id == id)
+            return row;
+    }
+    return -1;
+}
+
+float FaMonitor::amplitude(int id, size_t line, int axis) const
+{
+    const channel* c = find(id);
+    return c && 2 * line < c->amplitudes.size() ? c->amplitudes[2 * line + axis] : 0;
+}
+
+float FaMonitor::statistic(int id, int statistic, int axis) const
+{
+    const channel* c = find(id);
+    return c ? c->values[statistic][axis] : 0;
+}
+
+bool FaMonitor::coherence(int reference, int id, bool phase, fa::trace& out) const
+{
+    int a = row(reference);
+    int b = row(id);
+
+    if(!this->cross.ready() || a < 0 || b < 0 || size_t(b) >= this->cross.bpms())
+        return false;
+
+    this->cross.pair(a, b, phase, out);
+    return true;
+}
+
+bool FaMonitor::coherenceScan(int reference, fa::trace& out) const
+{
+    int a = row(reference);
+
+    if(!this->cross.ready() || a < 0 || size_t(a) >= this->cross.bpms())
+        return false;
+
+    this->cross.scan(a, this->crossLow, this->crossHigh, out);
+    return true;
+}
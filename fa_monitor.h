@@ -0,0 +1,226 @@
+#ifndef FA_MONITOR_H
+#define FA_MONITOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QTimer>
+
+#include <memory>
+#include <vector>
+
+#include <fa_acquisition.h>
+#include <fa_bus.h>
+#include <fa_cross.h>
+#include <fa_heatmap.h>
+#include <fa_lines.h>
+#include <fa_orbit.h>
+#include <fa_stats.h>
+#include <fa_trigger.h>
+
+#define FA_MONITOR_PERIOD   200
+#define FA_MONITOR_TIME     1.0
+#define FA_MONITOR_THRESHOLD    1.0
+#define FA_STATS_TIME       1.0
+#define FA_STATS_LOW        1.0
+#define FA_STATS_HIGH       100.0
+#define FA_ORBIT_TIME       1.0
+#define FA_ORBIT_PERIOD     2.0
+#define FA_COHERENCE_TIME   5.0
+#define FA_COHERENCE_PERIOD 1.0
+#define FA_COHERENCE_LOW    1.0
+#define FA_COHERENCE_HIGH   100.0
+#define FA_HEATMAP_TIME     1.0
+#define FA_HEATMAP_PERIOD   1.0
+#define FA_TRIGGER_LEVEL    100.0
+#define FA_TRIGGER_LOW      10.0
+#define FA_TRIGGER_HIGH     1000.0
+#define FA_TRIGGER_PRE      1.0
+#define FA_TRIGGER_POST     1.0
+#define FA_TRIGGER_HOLDOFF  5.0
+
+//
+// Ring-wide monitors: every configured BPM gets a fa::line_monitor for the
+// "monitor_lines" frequencies and, while enabled, a fa::bpm_stats over
+// "stats_time" windows. Both are fed from the BPM's bus on a timer of
+// their own, so they keep running while the display is frozen. The BPMs
+// are independent and are drained in parallel on the thread pool; a tick
+// that finds the previous batch still running is skipped, and the results
+// are copied out for the GUI thread once a batch has finished. Buses
+// published by an acquisition daemon on this host are read directly,
+// otherwise those of the viewer's own acquisition, which then has to
+// stream every BPM.
+//
+// While the orbit analysis is enabled, every "orbit_period" seconds the
+// last "orbit_time" seconds of all BPMs, aligned in time and in id (cell)
+// order, go through a fa::orbit_svd. Likewise, while the coherence is
+// enabled, the last "coherence_time" seconds go through a fa::coherence
+// once a second, and while the ring spectra are shown the last
+// "heatmap_time" seconds go through a fa::heatmap. The three are solved on
+// a worker of their own into spare instances, which are swapped with the
+// published ones once it has finished.
+//
+// None of the three is recomputed while the viewer is idle (minimised or
+// covered).
+//
+// With a "trigger_condition", every BPM also runs a fa::trigger on the same
+// samples. Once the "trigger_post" seconds after a firing have arrived, the
+// window from "trigger_pre" seconds before it is read back from the bus and
+// written to "trigger_path" by a worker.
+//
+class FaMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FaMonitor(const QJsonObject& config, FaAcquisition* acquisition, QObject *parent = nullptr);
+    ~FaMonitor();
+
+    // False without any "monitor_lines".
+    bool configured() const { return !this->lines.empty(); }
+
+    // Runs with lines configured or statistics enabled.
+    bool active() const { return configured() || armed() || this->statistics || this->orbiting || this->crossing || this->mapping; }
+
+    // True with a "trigger_condition".
+    bool armed() const { return this->condition != TRIGGER_OFF; }
+    void setStatistics(bool enabled);
+    void setOrbit(bool enabled);
+    void setCoherence(bool enabled);
+    void setHeatmap(bool enabled);
+
+    //
+    // Nothing is on screen: the orbit, coherence and ring spectra, only
+    // ever displayed, are not recomputed. Lines, statistics and triggers
+    // keep running for their alarms and events.
+    //
+    void setIdle(bool idle) { this->idle = idle; }
+
+    // Time (ms) the GUI thread spent taking in finished batches since the
+    // last call, the slots connected to the signals included.
+    double takeCost();
+
+    void start();
+
+    // Also waits for a batch that is still running.
+    void stop();
+
+    const std::vector<float>& frequencies() const { return this->lines; }
+    QList<int> ids() const;
+    float threshold() const { return this->limit; }
+
+    // Rms amplitude (um) of `line` on `axis` (0 for X, 1 for Y) of BPM `id`,
+    // zero until its first block has completed.
+    float amplitude(int id, size_t line, int axis) const;
+
+    // One of STATS_* (um) of BPM `id` over the last complete window.
+    float statistic(int id, int statistic, int axis) const;
+
+    // Top "orbit_modes" modes of the last window, rows in id order.
+    fa::orbit_svd& orbit() { return this->modes; }
+    size_t orbitModes() const { return this->rank; }
+
+    // Coherence (or phase) of BPM `id` against BPM `reference` over the
+    // last window, X against Y when both are the same BPM; and that of
+    // every BPM, in id order, over "coherence_band". False until the
+    // first window or for BPMs not monitored.
+    bool coherence(int reference, int id, bool phase, fa::trace& out) const;
+    bool coherenceScan(int reference, fa::trace& out) const;
+
+    // Spectra of every BPM over the last window, rows in id order.
+    const fa::heatmap& heatmap() const { return this->spectra; }
+
+signals:
+    // At least one BPM completed a block.
+    void updated();
+
+    // The ring spectra were recomputed.
+    void heatmapUpdated();
+
+    // An event of BPM `id` was written to `path`, or could not be.
+    void captured(int id, QString path, bool saved);
+
+private slots:
+    void poll();
+    void onDrained();
+    void onSolved();
+
+private:
+    bool align(int64_t& time, float& rate) const;
+    void gather(int64_t time, size_t length, float* x, float* y) const;
+    bool solveOrbit();
+    bool solveCoherence();
+    bool solveHeatmap();
+    void capture();
+
+private:
+    struct channel
+    {
+        int id;
+        fa::bus shared;
+        fa::bus* source;
+        uint64_t sequence;
+        fa::line_monitor monitor;
+        fa::bpm_stats stats;
+        fa::trigger trigger;
+        fa::event event;
+        bool capturing;
+
+        // Copies of the last results, only touched on the GUI thread.
+        std::vector<float> amplitudes;
+        float values[STATS_COUNT][2];
+    };
+
+    const channel* find(int id) const;
+    int row(int id) const;
+
+    FaAcquisition* acquisition;
+    QTimer* timer;
+    QFutureWatcher<void>* watcher;
+    QFutureWatcher<void>* solver;
+    std::vector<float> lines;
+    float time;
+    float limit;
+    float window;
+    float low;
+    float high;
+    bool statistics;
+    fa::orbit_svd modes;
+    fa::orbit_svd nextModes;
+    bool orbiting;
+    bool orbitSolved;
+    float span;
+    float period;
+    size_t rank;
+    QElapsedTimer solved;
+    fa::coherence cross;
+    fa::coherence nextCross;
+    bool crossing;
+    bool crossSolved;
+    float crossSpan;
+    float crossLow;
+    float crossHigh;
+    QElapsedTimer crossed;
+    fa::heatmap spectra;
+    fa::heatmap nextSpectra;
+    bool mapping;
+    bool mapSolved;
+    float mapSpan;
+    QElapsedTimer mapped;
+    int condition;
+    float level;
+    float triggerLow;
+    float triggerHigh;
+    float pre;
+    float post;
+    float holdoff;
+    QString path;
+    std::vector<std::unique_ptr<channel>> channels;
+    uint64_t blocks;
+    bool idle;
+    double cost;
+};
+
+#endif // FA_MONITOR_H
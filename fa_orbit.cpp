@@ -0,0 +1,179 @@
+#include "fa_orbit.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <opencv2/core/core.hpp>
+
+namespace fa
+{
+
+orbit_svd::orbit_svd() : cache(FA_ORBIT_MODES), rows(0), length(0), rate(0), solved(0)
+{
+}
+
+void orbit_svd::resize(size_t bpms, size_t length)
+{
+    this->rows = bpms;
+    this->length = length;
+    planes[0].resize(bpms * length);
+    planes[1].resize(bpms * length);
+}
+
+void orbit_svd::solve(float rate, size_t modes)
+{
+    if(rows == 0 || length < 2)
+        return;
+
+    this->rate = rate;
+    modes = std::min(modes, rows);
+    decompose(0, modes);
+    decompose(1, modes);
+    solved++;
+}
+
+void orbit_svd::decompose(int axis, size_t modes)
+{
+    std::vector<float>& x = planes[axis];
+    size_t blocks = (length + FA_ORBIT_BLOCK - 1) / FA_ORBIT_BLOCK;
+    size_t m = rows;
+    cv::Mat values;
+    cv::Mat eigenvectors;
+
+    // Every BPM's mean orbit over the window is removed first.
+    cv::parallel_for_(cv::Range(0, m), [&](const cv::Range& range) {
+        for(int i = range.start; i < range.end; i++) {
+            float* row = x.data() + i * length;
+            double sum = 0;
+            for(size_t t = 0; t < length; t++)
+                sum += row[t];
+            float mean = sum / length;
+            for(size_t t = 0; t < length; t++)
+                row[t] -= mean;
+        }
+    });
+
+    //
+    // Upper triangle of one partial Gram matrix per block of samples, then
+    // summed and mirrored.
+    //
+    gram.assign(blocks * m * m, 0);
+    cv::parallel_for_(cv::Range(0, blocks), [&](const cv::Range& range) {
+        for(int b = range.start; b < range.end; b++) {
+            size_t start = b * FA_ORBIT_BLOCK;
+            size_t stop = std::min<size_t>(length, start + FA_ORBIT_BLOCK);
+            double* partial = gram.data() + b * m * m;
+            for(size_t i = 0; i < m; i++) {
+                const float* row_i = x.data() + i * length;
+                for(size_t j = i; j < m; j++) {
+                    const float* row_j = x.data() + j * length;
+                    float sum = 0;
+                    for(size_t t = start; t < stop; t++)
+                        sum += row_i[t] * row_j[t];
+                    partial[i * m + j] = sum;
+                }
+            }
+        }
+    });
+
+    for(size_t b = 1; b < blocks; b++) {
+        for(size_t k = 0; k < m * m; k++)
+            gram[k] += gram[b * m * m + k];
+    }
+    for(size_t i = 0; i < m; i++) {
+        for(size_t j = 0; j < i; j++)
+            gram[i * m + j] = gram[j * m + i];
+    }
+
+    // Eigenvalues come out in descending order, the vectors as rows.
+    cv::eigen(cv::Mat(m, m, CV_64F, gram.data()), values, eigenvectors);
+
+    //
+    // A mode's sign is arbitrary, it is flipped so that its largest
+    // component is positive and does not blink between updates.
+    //
+    vectors[axis].resize(modes * m);
+    strengths[axis].resize(modes);
+    for(size_t k = 0; k < modes; k++) {
+        const double* u = eigenvectors.ptr<double>(k);
+        size_t peak = 0;
+        for(size_t i = 1; i < m; i++) {
+            if(std::abs(u[i]) > std::abs(u[peak]))
+                peak = i;
+        }
+
+        float sign = u[peak] < 0 ? -1 : 1;
+        for(size_t i = 0; i < m; i++)
+            vectors[axis][k * m + i] = sign * u[i];
+        strengths[axis][k] = std::sqrt(std::max(0.0, values.at<double>(k)) / length);
+    }
+
+    // Temporal modes, u^T x(t) for every sample, again block by block.
+    motion[axis].resize(modes * length);
+    cv::parallel_for_(cv::Range(0, blocks), [&](const cv::Range& range) {
+        size_t start = range.start * FA_ORBIT_BLOCK;
+        size_t stop = std::min<size_t>(length, range.end * FA_ORBIT_BLOCK);
+        for(size_t k = 0; k < modes; k++) {
+            float* out = motion[axis].data() + k * length;
+            std::fill(out + start, out + stop, 0);
+            for(size_t i = 0; i < m; i++) {
+                const float* row = x.data() + i * length;
+                float weight = vectors[axis][k * m + i];
+                for(size_t t = start; t < stop; t++)
+                    out[t] += weight * row[t];
+            }
+        }
+    });
+}
+
+void orbit_svd::shape(size_t k, trace& out) const
+{
+    out.index.resize(rows);
+    out.x.resize(rows);
+    out.y.resize(rows);
+    out.min = std::numeric_limits<float>::max();
+    out.max = -std::numeric_limits<float>::max();
+    for(size_t i = 0; i < rows; i++) {
+        out.index[i] = i;
+        out.x[i] = vectors[0][k * rows + i] * strengths[0][k];
+        out.y[i] = vectors[1][k * rows + i] * strengths[1][k];
+        out.min = std::min(out.min, std::min(out.x[i], out.y[i]));
+        out.max = std::max(out.max, std::max(out.x[i], out.y[i]));
+    }
+    out.bins = 0;
+}
+
+void orbit_svd::density(size_t k, trace& out)
+{
+    size_t segment = 2 * length / (FA_ORBIT_SEGMENTS + 1);
+    spectrum_key key{};
+    key.bpm = int(k);
+    key.end = solved;
+    key.length = segment;
+    key.hop = segment / 2;
+    key.segments = FA_ORBIT_SEGMENTS;
+    key.window = true;
+    key.frequency = rate;
+    key.phases = false;
+    key.hidden = 0;
+    const spectrum& power = cache.get(key, motion[0].data() + k * length, motion[1].data() + k * length);
+    size_t bins = power.power_x.size();
+
+    // The DC bin has no place on the log axis.
+    out.index.resize(bins > 0 ? bins - 1 : 0);
+    out.x.resize(out.index.size());
+    out.y.resize(out.index.size());
+    out.min = std::numeric_limits<float>::max();
+    out.max = std::numeric_limits<float>::min();
+    for(size_t b = 1; b < bins; b++) {
+        out.index[b - 1] = b * rate / segment;
+        out.x[b - 1] = std::sqrt(power.power_x[b]);
+        out.y[b - 1] = std::sqrt(power.power_y[b]);
+        out.min = std::min(out.min, std::min(out.x[b - 1], out.y[b - 1]));
+        out.max = std::max(out.max, std::max(out.x[b - 1], out.y[b - 1]));
+    }
+    out.bins = 0;
+}
+
+}
@@ -0,0 +1,73 @@
+#ifndef FA_ORBIT_H
+#define FA_ORBIT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include <fa_analysis.h>
+
+#define FA_ORBIT_MODES      4
+#define FA_ORBIT_BLOCK      1024
+#define FA_ORBIT_SEGMENTS   8
+
+namespace fa
+{
+
+//
+// Model-independent orbit analysis: a BPM x time window per plane is
+// decomposed as X = U S V^T. The columns of U are spatial modes (the
+// pattern a mode leaves around the ring), S their strengths and the rows
+// of V their motion in time. Beam motion shows up as a few strong modes
+// common to many BPMs, the noise of a single BPM as a weak mode localised
+// on it.
+//
+// With far fewer BPMs than samples, the exact SVD of every window comes
+// from the eigenvectors of the small BPM x BPM Gram matrix X X^T. It is
+// accumulated over blocks of FA_ORBIT_BLOCK samples (each block stays in
+// cache) on all cores and reduced afterwards. The temporal modes are the
+// projections u^T x(t), whose Welch spectra come from the spectrum cache
+// with the X and Y modes of the same rank paired up.
+//
+class orbit_svd
+{
+public:
+    orbit_svd();
+
+    // Window of `length` samples of `bpms` BPMs. plane(axis) then holds
+    // one row per BPM (um), to be filled before solve().
+    void resize(size_t bpms, size_t length);
+    std::vector<float>& plane(int axis) { return planes[axis]; }
+
+    void solve(float rate, size_t modes);
+
+    bool   ready()  const { return solved > 0; }
+    size_t bpms()   const { return rows; }
+    size_t modes()  const { return strengths[0].size(); }
+
+    // Rms amplitude (um) of mode `k` of a plane over the window.
+    float strength(int axis, size_t k) const { return strengths[axis][k]; }
+
+    // Mode `k` of both planes: its rms amplitude at every BPM (um), or the
+    // amplitude spectral density of its motion (um/sqrt(Hz)) against Hz.
+    void shape(size_t k, trace& out) const;
+    void density(size_t k, trace& out);
+
+private:
+    void decompose(int axis, size_t modes);
+
+    std::vector<float> planes[2];
+    std::vector<double> gram;
+    std::vector<float> vectors[2];
+    std::vector<float> strengths[2];
+    std::vector<float> motion[2];
+    spectrum_cache cache;
+    size_t rows;
+    size_t length;
+    float rate;
+    uint64_t solved;
+};
+
+}
+
+#endif // FA_ORBIT_H
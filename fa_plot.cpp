@@ -0,0 +1,101 @@
+#include "fa_plot.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace fa
+{
+
+float scale::position(float value) const
+{
+    if(this->log)
+        return (std::log10(value) - std::log10(this->low)) / (std::log10(this->high) - std::log10(this->low)) * this->pixels;
+    return (value - this->low) / (this->high - this->low) * this->pixels;
+}
+
+float scale::value(float position) const
+{
+    float fraction = position / this->pixels;
+
+    if(this->log)
+        return this->low * std::pow(this->high / this->low, fraction);
+    return this->low + fraction * (this->high - this->low);
+}
+
+int nice_range(float& low, float& high, int count)
+{
+    if(!(high > low) || count < 2)
+        return count;
+
+    float rough = (high - low) / (count - 1);
+    float magnitude = std::pow(10.0f, std::floor(std::log10(rough)));
+    float step = magnitude * (rough > 5 * magnitude ? 10 : rough > 2 * magnitude ? 5 : rough > magnitude ? 2 : 1);
+
+    low = std::floor(low / step) * step;
+    high = std::ceil(high / step) * step;
+    return std::lround((high - low) / step) + 1;
+}
+
+std::vector<float> ticks(const scale& axis, int count)
+{
+    std::vector<float> out;
+
+    if(!(axis.high > axis.low))
+        return out;
+
+    if(axis.log) {
+        for(float decade = std::ceil(std::log10(axis.low)); decade <= std::log10(axis.high) + 1e-4f; decade++)
+            out.push_back(std::pow(10.0f, decade));
+        return out;
+    }
+
+    for(int i = 0; i < count; i++)
+        out.push_back(axis.low + i * (axis.high - axis.low) / std::max(1, count - 1));
+    return out;
+}
+
+void columns::reduce(const float* index, const float* values, size_t count, const scale& x, const scale& y)
+{
+    size_t width = std::max(0, x.pixels) + 2;
+
+    this->first.resize(width);
+    this->last.resize(width);
+    this->low.resize(width);
+    this->high.resize(width);
+    this->used.assign(width, 0);
+    this->outside[0] = -1;
+    this->outside[1] = x.pixels + 1;
+
+    for(size_t i = 0; i < count; i++) {
+        if(!x.valid(index[i]) || !y.valid(values[i]) || std::isnan(values[i]))
+            continue;
+
+        float at = x.position(index[i]);
+        size_t column = at < 0 ? 0 : at >= x.pixels ? width - 1 : size_t(at) + 1;
+        float v = values[i];
+
+        //
+        // Off the left end only the nearest point matters, off the right
+        // end only the first one.
+        //
+        if(column == 0)
+            this->outside[0] = at;
+        else if(column == width - 1 && !this->used[column])
+            this->outside[1] = at;
+
+        if(!this->used[column] || column == 0) {
+            this->used[column] = 1;
+            this->first[column] = v;
+            this->low[column] = v;
+            this->high[column] = v;
+        }
+        else if(column == width - 1) {
+            continue;
+        }
+        this->last[column] = v;
+        this->low[column] = std::min(this->low[column], v);
+        this->high[column] = std::max(this->high[column], v);
+    }
+}
+
+}
@@ -0,0 +1,61 @@
+#ifndef FA_PLOT_H
+#define FA_PLOT_H
+
+#include <cstddef>
+#include <vector>
+
+#define FA_PLOT_TICKS 6
+
+namespace fa
+{
+
+//
+// One plot axis: [low, high] spread over `pixels`, linearly or linearly in
+// log10. Positions are in pixels from the low end and may fall outside
+// [0, pixels) for values off the range.
+//
+struct scale
+{
+    float low;
+    float high;
+    bool  log;
+    int   pixels;
+
+    float position(float value) const;
+    float value(float position) const;
+
+    // Usable on this axis, log axes cannot show values <= 0.
+    bool valid(float value) const { return !this->log || value > 0; }
+};
+
+//
+// Widens [low, high] to multiples of a 1, 2 or 5 step giving about `count`
+// ticks, returns the tick count.
+//
+int nice_range(float& low, float& high, int count);
+
+// Linear axes get `count` evenly spaced ticks, log axes one per decade.
+std::vector<float> ticks(const scale& axis, int count);
+
+//
+// One series reduced to its pixel columns: the first, last, lowest and
+// highest value of the points landing in each. Column 0 and column
+// `pixels + 1` collect what lies off either end, so the lines into view
+// keep their slope; `outside` holds their positions. However many points
+// there are, drawing costs two lines per column.
+//
+struct columns
+{
+    std::vector<float> first;
+    std::vector<float> last;
+    std::vector<float> low;
+    std::vector<float> high;
+    std::vector<unsigned char> used;
+    float outside[2];
+
+    void reduce(const float* index, const float* values, size_t count, const scale& x, const scale& y);
+};
+
+}
+
+#endif // FA_PLOT_H
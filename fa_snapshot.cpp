@@ -0,0 +1,87 @@
+#include "fa_snapshot.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace fa
+{
+
+void fill(snapshot& data, const snapshot_source& source)
+{
+    //
+    // As MainWindow::readWindow: the newest samples from the copies, the
+    // rest decoded from the histories, zero before they begin.
+    //
+    size_t hot = source.hot_x.size();
+    size_t cold = source.count - hot;
+    uint64_t end = data.end - hot;
+    size_t missing = cold > end ? cold - end : 0;
+
+    data.x.resize(source.count);
+    data.y.resize(source.count);
+    std::fill(data.x.begin(), data.x.begin() + missing, 0.0f);
+    std::fill(data.y.begin(), data.y.begin() + missing, 0.0f);
+    source.x.decode(end - (cold - missing), cold - missing, data.x.data() + missing, 1 / 1000.0);
+    source.y.decode(end - (cold - missing), cold - missing, data.y.data() + missing, 1 / 1000.0);
+    std::copy(source.hot_x.begin(), source.hot_x.end(), data.x.begin() + cold);
+    std::copy(source.hot_y.begin(), source.hot_y.end(), data.y.begin() + cold);
+}
+
+void envelope(const snapshot& data, size_t first, size_t start, size_t stop, size_t points, bool difference, trace& out)
+{
+    const float* x = data.x.data() + first;
+    const float* y = data.y.data() + first;
+    float spacing = 1000 / data.frequency;
+
+    // A step needs the sample before it.
+    stop = std::min(stop, data.x.size() - std::min(first, data.x.size()));
+    start = std::min(std::max<size_t>(start, difference ? 1 : 0), stop);
+    auto value = [&](const float* v, size_t i) { return difference ? v[i] - v[i - 1] : v[i]; };
+
+    size_t n = stop - start;
+    size_t buckets = n > points ? points / 2 : 0;
+
+    out.index.resize(buckets > 0 ? 2 * buckets : n);
+    out.x.resize(out.index.size());
+    out.y.resize(out.index.size());
+    out.min = std::numeric_limits<float>::max();
+    out.max = -std::numeric_limits<float>::max();
+    out.bins = 0;
+
+    if(buckets == 0) {
+        for(size_t i = 0; i < n; i++) {
+            out.index[i] = (start + i) * spacing;
+            out.x[i] = value(x, start + i);
+            out.y[i] = value(y, start + i);
+            out.min = std::min(out.min, std::min(out.x[i], out.y[i]));
+            out.max = std::max(out.max, std::max(out.x[i], out.y[i]));
+        }
+        return;
+    }
+
+    for(size_t b = 0; b < buckets; b++) {
+        size_t begin = start + b * n / buckets;
+        size_t end = start + (b + 1) * n / buckets;
+        float low_x = value(x, begin);
+        float high_x = low_x;
+        float low_y = value(y, begin);
+        float high_y = low_y;
+        for(size_t i = begin + 1; i < end; i++) {
+            low_x = std::min(low_x, value(x, i));
+            high_x = std::max(high_x, value(x, i));
+            low_y = std::min(low_y, value(y, i));
+            high_y = std::max(high_y, value(y, i));
+        }
+
+        out.index[2 * b] = begin * spacing;
+        out.index[2 * b + 1] = (begin + end) / 2 * spacing;
+        out.x[2 * b] = low_x;
+        out.x[2 * b + 1] = high_x;
+        out.y[2 * b] = low_y;
+        out.y[2 * b + 1] = high_y;
+        out.min = std::min(out.min, std::min(low_x, low_y));
+        out.max = std::max(out.max, std::max(high_x, high_y));
+    }
+}
+
+}
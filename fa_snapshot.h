@@ -0,0 +1,59 @@
+#ifndef FA_SNAPSHOT_H
+#define FA_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <fa_analysis.h>
+#include <fa_history.h>
+
+#define FA_SNAPSHOT_TIME    500
+#define FA_SNAPSHOT_POINTS  4000
+
+namespace fa
+{
+
+//
+// Full-rate copy of one BPM's recent history (um, oldest first), taken when
+// the display freezes. The first worker that redraws the frozen view fills
+// it from a snapshot_source; it is never modified afterwards, so later
+// workers share it read-only while acquisition goes on underneath.
+//
+struct snapshot
+{
+    int bpm;
+    uint64_t end;
+    float frequency;
+    std::vector<float> x;
+    std::vector<float> y;
+};
+
+//
+// What the last `count` samples before `end` are decoded from: views of
+// both compressed histories and copies of the newest samples (um), which
+// are still uncompressed. Taken on the GUI thread without decoding.
+//
+struct snapshot_source
+{
+    size_t count;
+    history_view x;
+    history_view y;
+    std::vector<float> hot_x;
+    std::vector<float> hot_y;
+};
+
+void fill(snapshot& data, const snapshot_source& source);
+
+//
+// Raw view of samples [start, stop) of the window that begins at sample
+// `first` of a snapshot, against ms from the window's start. Up to `points`
+// samples are shown as they are; a longer span is folded into points / 2
+// buckets drawn as their minimum and maximum, so a single-sample spike
+// still shows at any zoom. `difference` shows sample-to-sample steps.
+//
+void envelope(const snapshot& data, size_t first, size_t start, size_t stop, size_t points, bool difference, trace& out);
+
+}
+
+#endif // FA_SNAPSHOT_H
@@ -0,0 +1,103 @@
+#include "fa_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace fa
+{
+
+bpm_stats::bpm_stats() : cache(1), frequency(0), low(0), high(0), position(0), completed(0)
+{
+    clear();
+}
+
+void bpm_stats::configure(float rate, size_t length, float low, float high)
+{
+    this->frequency = rate;
+    this->low = low;
+    this->high = high;
+    window_x.resize(length);
+    window_y.resize(length);
+    clear();
+}
+
+void bpm_stats::clear()
+{
+    for(int i = 0; i < STATS_COUNT; i++)
+        values[i][0] = values[i][1] = 0;
+    cache.clear();
+    position = 0;
+    completed = 0;
+}
+
+void bpm_stats::push(const int32_t* samples, size_t count)
+{
+    size_t length = window_x.size();
+
+    if(length == 0)
+        return;
+
+    for(size_t n = 0; n < count; n++) {
+        window_x[position] = samples[2 * n] / 1000.0;
+        window_y[position] = samples[2 * n + 1] / 1000.0;
+        if(++position < length)
+            continue;
+
+        summarise();
+        position = 0;
+        completed++;
+    }
+}
+
+void bpm_stats::summarise()
+{
+    size_t length = window_x.size();
+    std::vector<float>* windows[2] = {&window_x, &window_y};
+    float step = frequency / length;
+
+    for(int axis = 0; axis < 2; axis++) {
+        std::vector<float>& window = *windows[axis];
+        auto range = std::minmax_element(window.begin(), window.end());
+        double sum = 0;
+        double squares = 0;
+
+        for(float value : window)
+            sum += value;
+        double mean = sum / length;
+        for(float& value : window) {
+            value -= mean;
+            squares += value * value;
+        }
+
+        values[STATS_MEAN][axis] = mean;
+        values[STATS_RMS][axis] = std::sqrt(squares / length);
+        values[STATS_P2P][axis] = *range.second - *range.first;
+    }
+
+    //
+    // The windows are centred above, so the offset does not leak into the
+    // lowest bins through the taper. The 1 + cos taper has a mean square of
+    // 1.5, which the spectrum carries and Parseval does not.
+    //
+    spectrum_key key{};
+    key.bpm = 0;
+    key.end = completed;
+    key.length = length;
+    key.hop = length;
+    key.segments = 1;
+    key.window = true;
+    key.frequency = frequency;
+    key.phases = false;
+    key.hidden = 0;
+    const spectrum& power = cache.get(key, window_x.data(), window_y.data());
+    for(int axis = 0; axis < 2; axis++) {
+        const std::vector<float>& density = axis == 0 ? power.power_x : power.power_y;
+        double band = 0;
+
+        for(size_t b = std::ceil(low / step); b < density.size() && b * step <= high; b++)
+            band += density[b] * step;
+        values[STATS_BAND_RMS][axis] = std::sqrt(band / 1.5);
+    }
+}
+
+}
@@ -0,0 +1,59 @@
+#ifndef FA_STATS_H
+#define FA_STATS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include <fa_analysis.h>
+
+#define STATS_MEAN      0
+#define STATS_RMS       1
+#define STATS_BAND_RMS  2
+#define STATS_P2P       3
+#define STATS_COUNT     4
+
+namespace fa
+{
+
+//
+// Summary statistics of one BPM over consecutive windows of `length`
+// samples: mean, rms about that mean, peak-to-peak and the rms within
+// [low, high] Hz. The band rms integrates the same Welch power spectrum the
+// integrated mode accumulates, taken from a one-entry spectrum cache. All
+// values are in um and describe the last complete window.
+//
+class bpm_stats
+{
+public:
+    bpm_stats();
+
+    void configure(float rate, size_t length, float low, float high);
+    void clear();
+
+    // `count` interleaved X/Y pairs (nm).
+    void push(const int32_t* samples, size_t count);
+
+    float rate() const { return frequency; }
+
+    // `statistic` is one of STATS_*, `axis` 0 for X and 1 for Y.
+    float value(int statistic, int axis) const { return values[statistic][axis]; }
+    uint64_t blocks() const { return completed; }
+
+private:
+    void summarise();
+
+    std::vector<float> window_x;
+    std::vector<float> window_y;
+    spectrum_cache cache;
+    float values[STATS_COUNT][2];
+    float frequency;
+    float low;
+    float high;
+    size_t position;
+    uint64_t completed;
+};
+
+}
+
+#endif // FA_STATS_H
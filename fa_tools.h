@@ -5,6 +5,8 @@
 #include <iterator>
 #include <iostream>
 #include <memory>
+#include <string>
+#include <cstring>
 
 namespace fa
 {
@@ -93,6 +95,8 @@ public:
             head = (head + 1) % N;
     }
 
+    void clear() { head = tail = count = 0; }
+
     const T* data() const { return &_data[head]; }
     const T* get()  const { return _data.get(); }
 
@@ -103,6 +107,74 @@ private:
     size_t count;
 };
 
+//
+// Splits a byte stream into '\n' terminated lines, whatever the read sizes.
+// Lines that do not straddle two reads are handed out in place.
+//
+class line_parser
+{
+public:
+    template <typename F>
+    void feed(const char* data, size_t size, F&& line)
+    {
+        const char* end = data + size;
+
+        while(data < end) {
+            const char* newline = static_cast<const char*>(memchr(data, '\n', end - data));
+            if(!newline) {
+                partial.append(data, end - data);
+                return;
+            }
+
+            if(partial.empty()) {
+                line(data, size_t(newline - data));
+            }
+            else {
+                partial.append(data, newline - data);
+                line(partial.data(), partial.size());
+                partial.clear();
+            }
+            data = newline + 1;
+        }
+    }
+
+    template <typename F>
+    void finish(F&& line)
+    {
+        if(!partial.empty())
+            line(partial.data(), partial.size());
+        partial.clear();
+    }
+
+private:
+    std::string partial;
+};
+
+//
+// Debug hook, built with `qmake CONFIG+=count_allocations`: heap blocks
+// the calling thread has asked malloc for so far, which covers every
+// operator new, the Qt containers and the C library alike. The viewer
+// aborts on any refresh tick that still allocates once the settings have
+// settled. Library calls that keep their own work buffers (cv::dft, the
+// QtConcurrent task) run in an `uncounted` scope, and what they allocate
+// is tallied apart by library_allocations(); a settled tick may not make
+// more of those than the first one did.
+//
+#ifdef FA_COUNT_ALLOCATIONS
+size_t allocations();
+size_t library_allocations();
+
+struct uncounted
+{
+    uncounted();
+    ~uncounted();
+};
+
+#define FA_UNCOUNTED    fa::uncounted uncounted_scope
+#else
+#define FA_UNCOUNTED
+#endif
+
 }
 
 #endif // FA_TOOLS_H
@@ -0,0 +1,193 @@
+#include "fa_trigger.h"
+#include "fa_history.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace fa
+{
+
+trigger::trigger() : condition(TRIGGER_OFF), frequency(0), limit(0), scale(1), alpha(0), b0(0), a1(0), a2(0),
+                     holdoff(0), quiet(0), primed(false), which(0), peak(0)
+{
+}
+
+void trigger::configure(int condition, float level, float low, float high, float rate, size_t holdoff)
+{
+    this->condition = condition;
+    this->frequency = rate;
+    this->holdoff = holdoff;
+
+    //
+    // Levels are compared in the stream's units: nm from the baseline, nm
+    // per sample, and nm^2 of mean-square band power. `scale` turns a value
+    // back into the level's unit.
+    //
+    if(condition == TRIGGER_THRESHOLD) {
+        limit = level * 1000;
+        scale = 1e-3;
+        alpha = 1 / (FA_TRIGGER_BASELINE * rate);
+    }
+    else if(condition == TRIGGER_DERIVATIVE) {
+        limit = level * 1000 * 1000 / rate;
+        scale = 1e-3 * rate / 1000;
+    }
+    else if(condition == TRIGGER_BAND_RMS) {
+        double centre = std::sqrt(low * high);
+        double w = 2 * M_PI * centre / rate;
+        double a = std::sin(w) * (high - low) / (2 * centre);
+
+        // RBJ band-pass with unit gain at the centre, b1 = 0 and b2 = -b0.
+        b0 = a / (1 + a);
+        a1 = -2 * std::cos(w) / (1 + a);
+        a2 = (1 - a) / (1 + a);
+        limit = double(level) * level * 1e6;
+        alpha = 1 / (FA_TRIGGER_RMS_TIME * rate);
+    }
+
+    clear();
+}
+
+void trigger::clear()
+{
+    memset(axes, 0, sizeof(axes));
+    quiet = 0;
+    primed = false;
+}
+
+template <int Condition>
+bool trigger::scan(const int32_t* samples, size_t count, uint64_t sequence, uint64_t& fired)
+{
+    bool found = false;
+
+    for(size_t n = 0; n < count; n++) {
+        int hit = -1;
+        double top = 0;
+
+        for(int a = 0; a < 2; a++) {
+            state& s = axes[a];
+            double x = samples[2 * n + a];
+            double value;
+
+            if(Condition == TRIGGER_THRESHOLD) {
+                value = std::abs(x - s.baseline);
+                s.baseline += alpha * (x - s.baseline);
+            }
+            else if(Condition == TRIGGER_DERIVATIVE) {
+                value = std::abs(x - s.previous);
+                s.previous = x;
+            }
+            else {
+                double y = b0 * x + s.z1;
+                s.z1 = -a1 * y + s.z2;
+                s.z2 = -b0 * x - a2 * y;
+                s.power += alpha * (y * y - s.power);
+                value = s.power;
+            }
+
+            if(value > limit && value > top) {
+                hit = a;
+                top = value;
+            }
+        }
+
+        if(quiet > 0) {
+            quiet--;
+        }
+        else if(hit >= 0 && !found) {
+            found = true;
+            fired = sequence + n;
+            which = hit;
+            peak = (Condition == TRIGGER_BAND_RMS ? std::sqrt(top) * 1e-3 : top * scale);
+            quiet = holdoff;
+        }
+    }
+
+    return found;
+}
+
+bool trigger::push(const int32_t* samples, size_t count, uint64_t sequence, uint64_t& fired)
+{
+    if(condition == TRIGGER_OFF || count == 0)
+        return false;
+
+    //
+    // The first sample seeds the baseline, the previous sample and the
+    // filter's steady state for a constant input, so the stream's offset
+    // does not fire at start.
+    //
+    if(!primed) {
+        for(int a = 0; a < 2; a++) {
+            axes[a].baseline = samples[a];
+            axes[a].previous = samples[a];
+            axes[a].z1 = -b0 * samples[a];
+            axes[a].z2 = -b0 * samples[a];
+        }
+        primed = true;
+    }
+
+    if(condition == TRIGGER_THRESHOLD)
+        return scan<TRIGGER_THRESHOLD>(samples, count, sequence, fired);
+    else if(condition == TRIGGER_DERIVATIVE)
+        return scan<TRIGGER_DERIVATIVE>(samples, count, sequence, fired);
+    return scan<TRIGGER_BAND_RMS>(samples, count, sequence, fired);
+}
+
+bool save_event(const std::string& path, const event& header, const int32_t* samples)
+{
+    uint32_t magic = FA_EVENT_MAGIC;
+    int32_t block[FA_BLOCK_SAMPLES];
+    uint32_t packed[block_words(32)];
+    FILE* file = fopen(path.c_str(), "wb");
+    bool ok;
+
+    if(!file)
+        return false;
+
+    ok = fwrite(&magic, sizeof(magic), 1, file) == 1 && fwrite(&header, sizeof(header), 1, file) == 1;
+    for(int axis = 0; axis < 2 && ok; axis++) {
+        for(size_t start = 0; start < header.count && ok; start += FA_BLOCK_SAMPLES) {
+            size_t count = std::min<size_t>(FA_BLOCK_SAMPLES, header.count - start);
+            for(size_t i = 0; i < FA_BLOCK_SAMPLES; i++)
+                block[i] = samples[2 * (start + std::min(i, count - 1)) + axis];
+            size_t words = encode_block(block, packed);
+            ok = fwrite(packed, sizeof(uint32_t), words, file) == words;
+        }
+    }
+
+    return fclose(file) == 0 && ok;
+}
+
+bool load_event(const std::string& path, event& header, std::vector<float>& x, std::vector<float>& y)
+{
+    uint32_t magic = 0;
+    uint32_t packed[block_words(32)];
+    float block[FA_BLOCK_SAMPLES];
+    FILE* file = fopen(path.c_str(), "rb");
+    bool ok;
+
+    if(!file)
+        return false;
+
+    ok = fread(&magic, sizeof(magic), 1, file) == 1 && magic == FA_EVENT_MAGIC && fread(&header, sizeof(header), 1, file) == 1;
+    x.resize(ok ? header.count : 0);
+    y.resize(ok ? header.count : 0);
+    for(int axis = 0; axis < 2 && ok; axis++) {
+        std::vector<float>& out = axis == 0 ? x : y;
+        for(size_t start = 0; start < header.count && ok; start += FA_BLOCK_SAMPLES) {
+            ok = fread(packed, sizeof(uint32_t), 2, file) == 2 && packed[1] <= 32;
+            ok = ok && fread(packed + 2, sizeof(uint32_t), block_words(packed[1]) - 2, file) == block_words(packed[1]) - 2;
+            if(!ok)
+                break;
+            decode_block(packed, block, 1e-3);
+            std::copy(block, block + std::min<size_t>(FA_BLOCK_SAMPLES, header.count - start), out.begin() + start);
+        }
+    }
+
+    fclose(file);
+    return ok;
+}
+
+}
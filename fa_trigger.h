@@ -0,0 +1,112 @@
+#ifndef FA_TRIGGER_H
+#define FA_TRIGGER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#define TRIGGER_OFF         -1
+#define TRIGGER_THRESHOLD   0
+#define TRIGGER_DERIVATIVE  1
+#define TRIGGER_BAND_RMS    2
+
+#define FA_TRIGGER_BASELINE 1.0
+#define FA_TRIGGER_RMS_TIME 0.1
+#define FA_EVENT_MAGIC      0x54564546  // "FEVT"
+
+namespace fa
+{
+
+//
+// Event trigger on one BPM's stream, evaluated on both axes sample by
+// sample as it arrives:
+//
+//  TRIGGER_THRESHOLD   distance (um) from a FA_TRIGGER_BASELINE second
+//                      exponential average of the position
+//  TRIGGER_DERIVATIVE  step between consecutive samples (um/ms)
+//  TRIGGER_BAND_RMS    rms (um) over FA_TRIGGER_RMS_TIME seconds of the
+//                      output of a [low, high] Hz band-pass biquad
+//
+// Each condition has its own loop, so a sample costs a handful of flops
+// and one compare per axis. After firing, the trigger stays quiet for
+// `holdoff` samples.
+//
+class trigger
+{
+public:
+    trigger();
+
+    void configure(int condition, float level, float low, float high, float rate, size_t holdoff);
+    void clear();
+
+    float rate() const { return frequency; }
+
+    // `count` interleaved X/Y pairs (nm), the first being absolute sample
+    // `sequence`. True when it fired, `fired` is then the first sample
+    // that crossed the level.
+    bool push(const int32_t* samples, size_t count, uint64_t sequence, uint64_t& fired);
+
+    // Axis (0 for X, 1 for Y) and value, in the level's unit, of the last
+    // firing.
+    int   axis()  const { return which; }
+    float value() const { return peak; }
+
+private:
+    template <int Condition>
+    bool scan(const int32_t* samples, size_t count, uint64_t sequence, uint64_t& fired);
+
+    struct state
+    {
+        double baseline;
+        double previous;
+        double z1;
+        double z2;
+        double power;
+    };
+
+    state axes[2];
+    int condition;
+    float frequency;
+    double limit;
+    double scale;
+    double alpha;
+    double b0;
+    double a1;
+    double a2;
+    size_t holdoff;
+    size_t quiet;
+    bool primed;
+    int which;
+    float peak;
+};
+
+//
+// A captured event: `count` samples of both axes from absolute sample
+// `first`, around the trigger at `sequence` (wall time `time`, ns).
+//
+struct event
+{
+    int      id;
+    int      condition;
+    int      axis;
+    float    value;
+    float    rate;
+    uint32_t count;
+    uint64_t sequence;
+    uint64_t first;
+    int64_t  time;
+};
+
+//
+// Event file: the event header, then the X and the Y samples as history
+// blocks (see encode_block), the last one padded with its final sample.
+// `samples` are `header.count` interleaved X/Y pairs (nm), `x` and `y` come
+// back in um.
+//
+bool save_event(const std::string& path, const event& header, const int32_t* samples);
+bool load_event(const std::string& path, event& header, std::vector<float>& x, std::vector<float>& y);
+
+}
+
+#endif // FA_TRIGGER_H
@@ -0,0 +1,95 @@
+#include "fa_waterfall.h"
+#include "fa_tools.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/core/core.hpp>
+
+namespace fa
+{
+
+palette::palette()
+{
+    //
+    // Black through blue, cyan and yellow to red, interpolated linearly
+    // between the anchors.
+    //
+    static const float anchors[5][3] = {{0, 0, 0}, {0, 0, 200}, {0, 200, 200}, {230, 230, 0}, {255, 0, 0}};
+    for(int i = 0; i < 256; i++) {
+        float position = i * 4 / 255.0f;
+        int k = std::min(3, int(position));
+        float t = position - k;
+        uint32_t rgb[3];
+        for(int c = 0; c < 3; c++)
+            rgb[c] = std::lround(anchors[k][c] + t * (anchors[k + 1][c] - anchors[k][c]));
+        colours[i] = 0xff000000 | rgb[0] << 16 | rgb[1] << 8 | rgb[2];
+    }
+}
+
+void palette::map(const float* values, size_t count, float low, float high, uint32_t* out)
+{
+    float scale = 255 / std::log(high / low);
+
+    levels.resize(count);
+    indices.resize(count);
+
+    FA_UNCOUNTED;
+    cv::Mat source(1, count, CV_32F, const_cast<float*>(values));
+    cv::Mat logs(1, count, CV_32F, levels.data());
+    cv::Mat index(1, count, CV_8U, indices.data());
+
+    cv::log(source, logs);
+    logs.convertTo(index, CV_8U, scale, -std::log(low) * scale);
+
+    //
+    // cv::LUT only maps channels onto as many channels, so the whole-pixel
+    // lookup from one index is a plain loop.
+    //
+    for(size_t i = 0; i < count; i++)
+        out[i] = colours[indices[i]];
+}
+
+waterfall::waterfall() : columns(0), capacity(0), filled(0), head(0), low(FA_WATERFALL_LOW), high(FA_WATERFALL_HIGH)
+{
+}
+
+void waterfall::resize(size_t width, size_t depth)
+{
+    if(width == columns && depth == capacity)
+        return;
+
+    columns = width;
+    capacity = depth;
+    pixels.assign(width * depth, 0xff000000);
+    clear();
+}
+
+void waterfall::set_range(float low, float high)
+{
+    this->low = low;
+    this->high = std::max(high, low * 1.001f);
+}
+
+void waterfall::clear()
+{
+    filled = 0;
+    head = 0;
+}
+
+void waterfall::push(const float* values)
+{
+    if(capacity == 0)
+        return;
+
+    head = (head + 1) % capacity;
+    filled = std::min(filled + 1, capacity);
+    colours.map(values, columns, low, high, pixels.data() + head * columns);
+}
+
+const uint32_t* waterfall::row(size_t age) const
+{
+    return pixels.data() + (head + capacity - age) % capacity * columns;
+}
+
+}
@@ -0,0 +1,71 @@
+#ifndef FA_WATERFALL_H
+#define FA_WATERFALL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define FA_WATERFALL_DEPTH  600
+#define FA_WATERFALL_LOW    1e-4
+#define FA_WATERFALL_HIGH   1.0
+
+namespace fa
+{
+
+//
+// Maps amplitudes onto 32-bit 0xffRRGGBB pixels (QImage::Format_RGB32) on a
+// logarithmic scale: `low` and below is black, `high` and above red. The
+// whole row goes through cv::log and a saturating conversion to a palette
+// index, both vectorised by OpenCV, then a table lookup per pixel.
+//
+class palette
+{
+public:
+    palette();
+
+    void map(const float* values, size_t count, float low, float high, uint32_t* out);
+
+private:
+    uint32_t colours[256];
+    std::vector<float> levels;
+    std::vector<uint8_t> indices;
+};
+
+//
+// Spectrogram history: one row of pixels per spectrum, the last `depth`
+// kept in a ring. push() only maps the new row, nothing moves in memory.
+//
+class waterfall
+{
+public:
+    waterfall();
+
+    // Rows of `width` pixels, `depth` of them. Clears the history when
+    // either changes.
+    void resize(size_t width, size_t depth);
+    void set_range(float low, float high);
+
+    void push(const float* values);
+    void clear();
+
+    size_t width() const { return columns; }
+    size_t depth() const { return capacity; }
+    size_t rows()  const { return filled; }
+
+    // Row `age` spectra ago, 0 being the newest, 0 <= age < rows().
+    const uint32_t* row(size_t age) const;
+
+private:
+    palette colours;
+    std::vector<uint32_t> pixels;
+    size_t columns;
+    size_t capacity;
+    size_t filled;
+    size_t head;
+    float low;
+    float high;
+};
+
+}
+
+#endif // FA_WATERFALL_H
@@ -0,0 +1,223 @@
+#include "gridview.h"
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <QWindow>
+#include <QtConcurrent>
+
+#include <cmath>
+
+static const QColor seriesColours[2] = {QColor(0x20, 0x9f, 0xdf), Qt::red};
+
+GridView::GridView(FaAcquisition* acquisition, QWidget *parent) :
+    QWidget(parent),
+    acquisition(acquisition),
+    mode(GRID_TRACES),
+    samples(10000)
+{
+    this->timer = new QTimer(this);
+    this->timer->setInterval(FA_GRID_PERIOD);
+    QObject::connect(this->timer, &QTimer::timeout, this, &GridView::tick);
+
+    this->watcher = new QFutureWatcher<void>(this);
+    QObject::connect(this->watcher, &QFutureWatcher<void>::finished, this, &GridView::onDrawn);
+
+    setAttribute(Qt::WA_OpaquePaintEvent, true);
+    setMinimumSize(300, 200);
+}
+
+GridView::~GridView()
+{
+    this->watcher->waitForFinished();
+}
+
+void GridView::setBPMs(const QList<int>& ids, const QStringList& names)
+{
+    // The workers hold references into the tiles.
+    this->watcher->waitForFinished();
+    this->tiles.clear();
+
+    for(int i = 0; i < ids.size() && i < FA_GRID_TILES; i++) {
+        std::unique_ptr<tile> t(new tile);
+        t->id = ids[i];
+        t->name = names.value(i, QString::number(ids[i]));
+        t->source = t->shared.attach(this->acquisition->sharedName(t->id)) ? &t->shared : this->acquisition->bus(t->id);
+        this->tiles.push_back(std::move(t));
+    }
+    update();
+}
+
+void GridView::setMode(int mode)
+{
+    this->mode = mode;
+}
+
+void GridView::setSamples(size_t samples)
+{
+    this->samples = qBound<size_t>(16, samples, FA_BUS_SAMPLES / 2);
+}
+
+QRect GridView::cell(size_t index) const
+{
+    int columns = std::ceil(std::sqrt(double(this->tiles.size())));
+    int rows = (this->tiles.size() + columns - 1) / qMax(1, columns);
+    int w = width() / qMax(1, columns);
+    int h = height() / qMax(1, rows);
+
+    return QRect(index % columns * w, index / columns * h, w, h);
+}
+
+void GridView::tick()
+{
+    // Nothing to draw for while the window is minimised or covered.
+    QWindow* window = this->window()->windowHandle();
+    if(this->watcher->isRunning() || this->tiles.empty() || !window || !window->isExposed())
+        return;
+
+    for(size_t i = 0; i < this->tiles.size(); i++)
+        this->tiles[i]->size = cell(i).size();
+
+    int mode = this->mode;
+    size_t samples = this->samples;
+    this->watcher->setFuture(QtConcurrent::map(this->tiles, [mode, samples](std::unique_ptr<tile>& t) {
+        draw(*t, mode, samples);
+    }));
+}
+
+void GridView::onDrawn()
+{
+    for(auto& t : this->tiles)
+        std::swap(t->image, t->next);
+    update();
+}
+
+void GridView::draw(tile& t, int mode, size_t samples)
+{
+    if(t.size.width() < 4 || t.size.height() < 4)
+        return;
+
+    t.next = QImage(t.size, QImage::Format_RGB32);
+    t.next.fill(Qt::white);
+    QPainter painter(&t.next);
+    QRect plot(2, 16, t.size.width() - 4, t.size.height() - 18);
+    painter.setPen(Qt::black);
+    painter.drawText(4, 1, t.size.width() - 8, 14, Qt::AlignLeft | Qt::AlignVCenter, t.name);
+    painter.setPen(QColor(0xd8, 0xd8, 0xd8));
+    painter.drawRect(plot);
+
+    //
+    // The newest window on the bus, the same span as fa::bus::fetch would
+    // give from `end - samples`.
+    //
+    float rate = t.source ? t.source->frequency() : 0;
+    uint64_t end = rate > 0 ? t.source->sequence() : 0;
+    uint64_t last = end - std::min<uint64_t>(end, samples);
+    size_t count = 0;
+    const int32_t* data = end >= samples ? t.source->fetch(last, count) : nullptr;
+    if(!data || count < samples)
+        return;
+
+    t.x.resize(samples);
+    t.y.resize(samples);
+    for(size_t i = 0; i < samples; i++) {
+        t.x[i] = data[2 * i] / 1000.0;
+        t.y[i] = data[2 * i + 1] / 1000.0;
+    }
+
+    if(mode == GRID_SPECTRA) {
+        fa::analysis_config config{};
+        config.mode       = MODE_FFT_LOGF;
+        config.decimation = DECIMATION_1_1;
+        config.ratio      = 1;
+        config.window     = true;
+        config.samples    = int(samples);
+        config.averages   = 10;
+        config.logFilter  = 1;
+        config.frequency  = rate;
+        if(config != t.analysis.config())
+            t.analysis.configure(config);
+        t.analysis.run(t.id, end, t.x, t.y, t.trace);
+    }
+    else {
+        t.trace.index.resize(samples);
+        for(size_t i = 0; i < samples; i++)
+            t.trace.index[i] = i * 1000 / rate;
+        std::swap(t.trace.x, t.x);
+        std::swap(t.trace.y, t.y);
+        t.trace.min = std::min(*std::min_element(t.trace.x.begin(), t.trace.x.end()), *std::min_element(t.trace.y.begin(), t.trace.y.end()));
+        t.trace.max = std::max(*std::max_element(t.trace.x.begin(), t.trace.x.end()), *std::max_element(t.trace.y.begin(), t.trace.y.end()));
+    }
+    if(t.trace.index.size() < 2)
+        return;
+
+    //
+    // Column-reduced like the main plot, on the tile's own worker.
+    //
+    bool logs = mode == GRID_SPECTRA;
+    float low = t.trace.min;
+    float high = t.trace.max;
+    if(logs && low <= 0)
+        low = high * 1e-6f;
+    if(!(high > low)) {
+        low = logs ? low / 10 : low - 1;
+        high = logs ? high * 10 : high + 1;
+    }
+    fa::scale x = {t.trace.index.front(), t.trace.index.back(), logs, plot.width()};
+    fa::scale y = {low, high, logs, plot.height()};
+    const std::vector<float>* values[2] = {&t.trace.x, &t.trace.y};
+
+    painter.setClipRect(plot);
+    for(int s = 0; s < 2; s++) {
+        fa::columns& c = t.reduced[s];
+        c.reduce(t.trace.index.data(), values[s]->data(), t.trace.index.size(), x, y);
+
+        auto at = [&](float v) { return plot.bottom() - y.position(v); };
+        size_t end = c.used.size() - 1;
+        bool started = false;
+        QPointF previous;
+        painter.setPen(seriesColours[s]);
+        for(size_t i = 1; i < end; i++) {
+            if(!c.used[i])
+                continue;
+            qreal column = plot.left() + i - 0.5;
+            if(started)
+                painter.drawLine(previous, QPointF(column, at(c.first[i])));
+            if(c.high[i] > c.low[i])
+                painter.drawLine(QPointF(column, at(c.low[i])), QPointF(column, at(c.high[i])));
+            previous = QPointF(column, at(c.last[i]));
+            started = true;
+        }
+    }
+}
+
+void GridView::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    QPainter painter(this);
+
+    painter.fillRect(rect(), Qt::white);
+    for(size_t i = 0; i < this->tiles.size(); i++) {
+        if(!this->tiles[i]->image.isNull())
+            painter.drawImage(cell(i).topLeft(), this->tiles[i]->image);
+    }
+}
+
+void GridView::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    this->timer->start();
+}
+
+void GridView::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+    this->timer->stop();
+}
+
+void GridView::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    for(size_t i = 0; i < this->tiles.size(); i++) {
+        if(cell(i).contains(event->pos()))
+            emit bpmSelected(this->tiles[i]->id);
+    }
+}
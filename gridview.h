@@ -0,0 +1,95 @@
+#ifndef GRIDVIEW_H
+#define GRIDVIEW_H
+
+#include <QWidget>
+#include <QImage>
+#include <QTimer>
+#include <QFutureWatcher>
+
+#include <memory>
+#include <vector>
+
+#include <fa_acquisition.h>
+#include <fa_analysis.h>
+#include <fa_bus.h>
+#include <fa_plot.h>
+
+#define FA_GRID_PERIOD  100
+#define FA_GRID_TILES   64
+
+#define GRID_TRACES     0
+#define GRID_SPECTRA    1
+
+//
+// Small multiples: one tile per BPM, each showing the last window of its
+// X and Y positions, or their log-f spectra. While shown, every tick hands
+// all tiles to the thread pool; each reads its own BPM's bus, analyses the
+// window and rasterises it into an image of its own. The GUI thread only
+// blits the finished images, and a tick that finds the previous batch
+// still running is skipped rather than queued.
+//
+class GridView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit GridView(FaAcquisition* acquisition, QWidget *parent = nullptr);
+    ~GridView();
+
+    // At most FA_GRID_TILES BPMs, in the order given.
+    void setBPMs(const QList<int>& ids, const QStringList& names);
+
+    void setMode(int mode);
+
+    //
+    // Window length in samples, limited to half of what a bus holds
+    // (FA_BUS_SAMPLES / 2, about 6.5 s at 10 kHz); window() is what is
+    // drawn.
+    //
+    void setSamples(size_t samples);
+    size_t window() const { return this->samples; }
+
+    bool active() const { return isVisible() && !this->tiles.empty(); }
+
+signals:
+    // A tile was double-clicked.
+    void bpmSelected(int id);
+
+protected:
+    void paintEvent(QPaintEvent *event);
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
+    void mouseDoubleClickEvent(QMouseEvent *event);
+
+private:
+    struct tile
+    {
+        int id;
+        QString name;
+        fa::bus shared;
+        fa::bus* source;
+        std::vector<float> x;
+        std::vector<float> y;
+        fa::analysis analysis;
+        fa::trace trace;
+        fa::columns reduced[2];
+        QSize size;
+        QImage next;
+        QImage image;
+    };
+
+    static void draw(tile& t, int mode, size_t samples);
+
+    QRect cell(size_t index) const;
+    void tick();
+    void onDrawn();
+
+    FaAcquisition* acquisition;
+    std::vector<std::unique_ptr<tile>> tiles;
+    QTimer* timer;
+    QFutureWatcher<void>* watcher;
+    int mode;
+    size_t samples;
+};
+
+#endif // GRIDVIEW_H
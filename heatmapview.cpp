@@ -0,0 +1,73 @@
+#include "heatmapview.h"
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <QToolTip>
+
+#include <cmath>
+
+HeatmapView::HeatmapView(QWidget *parent) :
+    QWidget(parent),
+    map(nullptr),
+    axis(0),
+    group(0)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent, true);
+    setMouseTracking(true);
+    setMinimumSize(200, 100);
+}
+
+void HeatmapView::setHeatmap(const fa::heatmap* map, int axis, const QStringList& names, int group)
+{
+    this->map = map;
+    this->axis = axis;
+    this->names = names;
+    this->group = group;
+    update();
+}
+
+void HeatmapView::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    QPainter painter(this);
+
+    if(!this->map || !this->map->ready() || this->map->columns() < 2) {
+        painter.fillRect(rect(), Qt::black);
+        return;
+    }
+
+    int rows = this->map->bpms();
+    int columns = this->map->columns();
+    QImage image(reinterpret_cast<const uchar*>(this->map->image(this->axis)), columns, rows, columns * 4, QImage::Format_RGB32);
+    painter.drawImage(rect(), image);
+
+    painter.setPen(QPen(Qt::gray, 1));
+    for(int r = this->group; this->group > 0 && r < rows; r += this->group)
+        painter.drawLine(0, r * height() / rows, width(), r * height() / rows);
+
+    //
+    // Columns are evenly spaced in log f, a decade tick lands where its
+    // frequency would be.
+    //
+    float low = std::log10(this->map->frequency(0));
+    float step = (std::log10(this->map->frequency(columns - 1)) - low) / (columns - 1);
+    painter.setPen(Qt::white);
+    for(int decade = std::ceil(low); decade <= low + step * columns; decade++) {
+        int x = (decade - low) / step * width() / columns;
+        painter.drawLine(x, 0, x, height());
+        painter.drawText(x + 3, 12, QString::number(std::pow(10, decade), 'g', 6) + " Hz");
+    }
+}
+
+void HeatmapView::mouseMoveEvent(QMouseEvent *event)
+{
+    if(!this->map || !this->map->ready() || width() <= 0 || height() <= 0)
+        return;
+
+    int row = qBound(0, event->pos().y() * int(this->map->bpms()) / height(), int(this->map->bpms()) - 1);
+    int column = qBound(0, event->pos().x() * int(this->map->columns()) / width(), int(this->map->columns()) - 1);
+    QToolTip::showText(event->globalPos(), QString::asprintf("%s, %.1f Hz: %.3g um/√Hz",
+                                                             this->names.value(row).toStdString().c_str(),
+                                                             this->map->frequency(column),
+                                                             this->map->amplitude(this->axis, row, column)), this);
+}
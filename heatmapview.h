@@ -0,0 +1,36 @@
+#ifndef HEATMAPVIEW_H
+#define HEATMAPVIEW_H
+
+#include <QWidget>
+#include <QStringList>
+
+#include <fa_heatmap.h>
+
+//
+// Ring spectra of one plane as an image: one row per BPM, separated cell by
+// cell, log-frequency columns with a tick at every decade. The pixels are
+// drawn straight from the fa::heatmap, hovering shows the BPM, frequency
+// and amplitude under the cursor.
+//
+class HeatmapView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit HeatmapView(QWidget *parent = nullptr);
+
+    // Rows are named by `names`, with a line every `group` rows.
+    void setHeatmap(const fa::heatmap* map, int axis, const QStringList& names, int group);
+
+protected:
+    void paintEvent(QPaintEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
+
+private:
+    const fa::heatmap* map;
+    int axis;
+    QStringList names;
+    int group;
+};
+
+#endif // HEATMAPVIEW_H
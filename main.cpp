@@ -1,9 +1,154 @@
 #include "main_window.h"
+#include "fa_daemon.h"
 
 #include <QApplication>
+#include <QSocketNotifier>
+#include <csignal>
+#include <unistd.h>
+
+#ifdef FA_COUNT_ALLOCATIONS
+#include <cerrno>
+
+//
+// Every allocator entry point is replaced, so operator new in all its
+// forms, Qt and the libraries are counted through the same few calls. The
+// blocks still come from glibc, whose free() releases them.
+//
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* memory, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void* __libc_valloc(size_t size);
+}
+
+static thread_local size_t allocated = 0;
+static thread_local size_t excused = 0;
+static thread_local int paused = 0;
+
+size_t fa::allocations() { return allocated; }
+size_t fa::library_allocations() { return excused; }
+fa::uncounted::uncounted() { paused++; }
+fa::uncounted::~uncounted() { paused--; }
+
+static inline void tally()
+{
+    if(paused)
+        excused++;
+    else
+        allocated++;
+}
+
+extern "C" void* malloc(size_t size) noexcept
+{
+    tally();
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) noexcept
+{
+    tally();
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* memory, size_t size) noexcept
+{
+    tally();
+    return __libc_realloc(memory, size);
+}
+
+extern "C" void* memalign(size_t alignment, size_t size) noexcept
+{
+    tally();
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    tally();
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** out, size_t alignment, size_t size) noexcept
+{
+    if(alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+    tally();
+    void* memory = __libc_memalign(alignment, size);
+    if(!memory)
+        return ENOMEM;
+    *out = memory;
+    return 0;
+}
+
+extern "C" void* valloc(size_t size) noexcept
+{
+    tally();
+    return __libc_valloc(size);
+}
+#endif
+
+//
+// A signal handler may only do async-signal-safe work, so it just writes a
+// byte to a pipe. The event loop sees the pipe become readable and quits.
+//
+static int signalPipe[2] = {-1, -1};
+
+static void onSignal(int)
+{
+    char byte = 1;
+    ssize_t written = ::write(signalPipe[1], &byte, 1);
+    Q_UNUSED(written);
+}
 
 int main(int argc, char *argv[])
 {
+    if(argc > 1 && QString(argv[1]) == "--daemon") {
+        QCoreApplication a(argc, argv);
+
+        // --force replaces buses a daemon that did not exit cleanly left.
+        int next = 2;
+        bool force = argc > next && QString(argv[next]) == "--force";
+        if(force)
+            next++;
+
+        QString configFile = QString(argv[next]);
+        if(configFile.isEmpty())
+            configFile = ":/fa-config.json";
+        FaDaemon daemon(configFile, force);
+        if(!daemon.start())
+            return 1;
+
+        if(::pipe(signalPipe) != 0)
+            return 1;
+        QSocketNotifier notifier(signalPipe[0], QSocketNotifier::Read);
+        QObject::connect(&notifier, QOverload<int>::of(&QSocketNotifier::activated), &a, [](int) { QCoreApplication::quit(); });
+        std::signal(SIGINT,  onSignal);
+        std::signal(SIGTERM, onSignal);
+        return a.exec();
+    }
+
+    //
+    // A captured event, printed as time (ms from the trigger), X and Y (um)
+    // for plotting elsewhere.
+    //
+    if(argc > 2 && QString(argv[1]) == "--event") {
+        fa::event header;
+        std::vector<float> x;
+        std::vector<float> y;
+
+        if(!fa::load_event(argv[2], header, x, y)) {
+            cout << "Could not read event file " << argv[2] << endl;
+            return 1;
+        }
+
+        printf("# BPM %d, condition %d on %s, value %g, trigger at sample %llu\n", header.id, header.condition,
+               header.axis == 0 ? "X" : "Y", header.value, (unsigned long long) header.sequence);
+        for(size_t i = 0; i < x.size(); i++)
+            printf("%.3f %.3f %.3f\n", (double(header.first + i) - header.sequence) * 1000 / header.rate, x[i], y[i]);
+        return 0;
+    }
+
     QApplication a(argc, argv);
 
     QString configFile = QString(argv[1]);
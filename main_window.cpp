@@ -7,6 +7,9 @@ MainWindow::MainWindow(QString configFile, QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
 {
+    this->startup.start();
+    this->firstTrace = false;
+
     QFile file(configFile);
     if(configFile.isEmpty() || !file.open(QIODevice::ReadOnly | QIODevice::Text)) {
         QMessageBox::warning(this, "Error", "Could not open FA configuration file.", QMessageBox::Ok);
@@ -20,68 +23,35 @@ MainWindow::MainWindow(QString configFile, QWidget *parent)
         layout->setContentsMargins(0, 0, 0, 0);
     }
 
-    x_series = new QLineSeries(this);
-    y_series = new QLineSeries(this);
-    x_series->setName("Horizontal");
-    y_series->setName("Vertical");
-    y_series->setPen(QPen(Qt::red));
-
-    this->xAxis = new QValueAxis;
-    this->xAxis->setTitleText("Samples");
-    this->xAxis->setTickCount(6);
-    this->xAxis->setLabelFormat("%d");
-
-    this->yAxis = new QValueAxis;
-    this->yAxis->setTickType(QValueAxis::TicksFixed);
-    this->yAxis->setMinorTickCount(2);
-    this->yAxis->applyNiceNumbers();
-    this->yAxis->setTitleText("Positions");
-
-    this->yLogAxis = new QLogValueAxis;
-    this->yLogAxis->setTitleText("Amplitudes");
-    this->yLogAxis->setBase(10);
-    this->yLogAxis->setMinorGridLineVisible(false);
-    this->yLogAxis->setLabelFormat("%g");
-
-    this->xLogAxis = new QLogValueAxis;
-    this->xLogAxis->setTitleText("Frequency (Hz)");
-    this->xLogAxis->setBase(10);
-    this->xLogAxis->setMinorGridLineVisible(false);
-    this->xLogAxis->setLabelFormat("%g");
-
-    chart = new Chart;
-    chart->addSeries(x_series);
-    chart->addSeries(y_series);
-    this->chart->addAxis(this->xAxis, Qt::AlignBottom);
-    this->chart->addAxis(this->yAxis, Qt::AlignLeft);
-    this->chart->addAxis(this->xLogAxis, Qt::AlignBottom);
-    this->chart->addAxis(this->yLogAxis, Qt::AlignLeft);
-    this->x_series->attachAxis(this->xAxis);
-    this->x_series->attachAxis(this->yAxis);
-    this->y_series->attachAxis(this->xAxis);
-    this->y_series->attachAxis(this->yAxis);
-
-    QFont font;
-    font.setBold(true);
-    font.setPixelSize(18);
-    chart->setTitleFont(font);
-    chart->legend()->show();
-
-    chartView = new ChartView(chart);
-    // chartView->setRenderHint(QPainter::Antialiasing);
-    chartView->viewport()->setMouseTracking(true);
-    ui->plot->layout()->addWidget(chartView);
+    traceView = new TraceView;
+    ui->plot->layout()->addWidget(traceView);
 
+    //
+    // Acquisition drains the stream at a fixed short period whatever the
+    // refresh. Analysis runs on its own timer at the window's period, or
+    // slower when it cannot keep up, and the trace view draws the newest
+    // result on its worker, dropping any it had no time for.
+    //
     this->timer = new QTimer(this);
-    this->timer->setInterval(1000);
+    this->timer->setInterval(FA_INGEST_PERIOD);
     QObject::connect(this->timer, &QTimer::timeout, this, &MainWindow::pollServer);
-    QObject::connect(ui->btnConnect, &QPushButton::clicked, this, &MainWindow::reconnectToServer);
 
-    QString id;
+    this->frameTimer = new QTimer(this);
+    this->frameTimer->setInterval(1000);
+    QObject::connect(this->frameTimer, &QTimer::timeout, this, &MainWindow::onFrame);
+    this->frameTimer->start();
+    this->analysisCost = 0;
+    this->analyses = 0;
+    this->displayed = 0;
+    this->rateClock.start();
+    this->rateLabel = new QLabel(this);
+    this->statusBar()->addPermanentWidget(this->rateLabel);
+    QObject::connect(ui->btnConnect, &QPushButton::clicked, this, [this]() { this->acquisition->reconnect(); reconnectToServer(); });
+
     QTextStream config(&file);
     QJsonDocument faConfig = QJsonDocument::fromJson(QString(config.readAll()).toUtf8());
     QJsonObject object = faConfig.object();
-    if(object.value("ip_address").isNull() || object.value("port").isNull() ||
+    if(((object.value("ip_address").isNull() || object.value("port").isNull()) && object.value("servers").isNull()) ||
        object.value("id_format").isNull()  || object.value("ids").isNull()  ||
        object.value("bpms_cell").isNull()  || object.value("cells").isNull() ||
        object.value("first_id").isNull())
@@ -95,378 +65,577 @@ MainWindow::MainWindow(QString configFile, QWidget *parent)
     this->format  = object.value("id_format").toString();
     this->firstID = object.value("first_id").toInt();
     this->ids     = object.value("ids").toInt();
-    this->ipAddress = object.value("ip_address").toString();
-    this->port    = object.value("port").toInt();
+
+    this->currentID = this->firstID;
+    this->busSequence = 0;
+    this->samplingFrequency = SAMPLING_RATE;
+    this->samples = mSamples[3];
+    this->steadyTicks = 0;
+    this->libraryBudget = 0;
+
+    this->fftAverages = qMax(2, object.value("fft_averages").toInt(FA_FFT_AVERAGES));
+    this->fftOverlap = qBound(0.0, object.value("fft_overlap").toDouble(0), 0.9);
+    this->bandLow = 0;
+    this->bandHigh = 0;
+    this->streaming = false;
+
+    // Sized for the nominal rate until the server has sent its own.
+    this->historyTime = object.value("history").toInt(FA_HISTORY_TIME);
+    this->historyX.set_capacity(size_t(this->historyTime * this->samplingFrequency));
+    this->historyY.set_capacity(size_t(this->historyTime * this->samplingFrequency));
+
+    std::string spillPath = object.value("spill_path").toString().toStdString();
+    uint64_t spillBudget = object.value("spill_budget").toInt(FA_SPILL_BUDGET) * (1ull << 20);
+    int64_t spillRetention = object.value("spill_retention").toInt(FA_SPILL_RETENTION) * 3600ll;
+    // The budget is per BPM, half of it for each plane.
+    this->historyX.set_spill(spillPath, spillBudget / 2, spillRetention);
+    this->historyY.set_spill(spillPath, spillBudget / 2, spillRetention);
 
     ui->txtBPM->setVisible(false);
     ui->txtBPM->setValidator(new QIntValidator(this->firstID, this->firstID + this->ids - 1));
 
-    int status;
-    char buffer[1600];
-    ssize_t bytes;
-    struct pollfd fds[1];
-    fds[0].fd = this->sock;
-    fds[0].events = POLLIN;
-    fds[0].revents = 0;
-
-    initSocket();
-    ::write(this->sock, FA_CMD_CL, strlen(FA_CMD_CL));
-    status = ::poll(fds, 1, 1000);
-    if(status <= 0 && errno != 0 && errno != EINPROGRESS)
-    {
-        QMessageBox::warning(this, "Error", "Socket I/O Error: " + QString(strerror(errno)));
-        ::close(this->sock);
-        ::exit(5);
-    }
-
-    bytes = ::read(this->sock, buffer, sizeof(buffer));
-    if(bytes >= 0) {
-        buffer[bytes] = '\0';
-        QString lines(buffer);
-        for(QString item : lines.split('\n')) {
-            if(!item.isEmpty())
-                this->bpmIDs.push_back(item.split(' ').last());
-        }
+    this->acquisition = new FaAcquisition(object, false, false, this);
+    QObject::connect(this->acquisition, &FaAcquisition::connectionChanged, this, &MainWindow::onConnectionChanged);
+    QObject::connect(this->acquisition, &FaAcquisition::bpmListChanged, this, &MainWindow::onBPMListChanged);
+
+    this->monitor = new FaMonitor(object, this->acquisition, this);
+    this->linesDock = nullptr;
+    this->linesTable = nullptr;
+    this->linesAlarm = nullptr;
+    ui->cbLines->setVisible(this->monitor->configured());
+    if(this->monitor->configured()) {
+        QStringList headers;
+        for(float line : this->monitor->frequencies())
+            headers << QString::number(line) + " Hz";
+
+        this->linesTable = new QTableWidget(0, headers.size(), this);
+        this->linesTable->setHorizontalHeaderLabels(headers);
+        this->linesTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        this->linesTable->setToolTip("X / Y rms amplitude (um)");
+        this->linesDock = new QDockWidget("Line monitor", this);
+        this->linesDock->setWidget(this->linesTable);
+        this->addDockWidget(Qt::RightDockWidgetArea, this->linesDock);
+        this->linesDock->hide();
+        this->linesAlarm = new QLabel(this);
+        this->linesAlarm->setStyleSheet("color: red");
+        this->statusBar()->addPermanentWidget(this->linesAlarm);
+        QObject::connect(this->linesDock, &QDockWidget::visibilityChanged, ui->cbLines, &QCheckBox::setChecked);
+        QObject::connect(this->monitor, &FaMonitor::updated, this, &MainWindow::updateLines);
     }
 
-    int currentID = this->firstID;
-    for(int cell = 1; cell <= this->cells; cell++) {
-        if(currentID > this->ids)
-            break;
+    //
+    // Ring statistics: one row per cell, one column per BPM of the cell,
+    // coloured by the selected statistic against the ring median.
+    //
+    auto statsPanel = new QWidget(this);
+    auto statsLayout = new QVBoxLayout(statsPanel);
+    this->statsShow = new QComboBox(statsPanel);
+    this->statsShow->addItems({"Mean X", "Mean Y", "RMS X", "RMS Y", "Band RMS X", "Band RMS Y", "Peak-to-peak X", "Peak-to-peak Y"});
+    this->statsTable = new QTableWidget(this->cells, this->bpms, statsPanel);
+    this->statsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    this->statsTable->setToolTip("um, last window");
+    statsLayout->setContentsMargins(0, 0, 0, 0);
+    statsLayout->addWidget(this->statsShow);
+    statsLayout->addWidget(this->statsTable);
+    this->statsDock = new QDockWidget("Ring statistics", this);
+    this->statsDock->setWidget(statsPanel);
+    this->addDockWidget(Qt::RightDockWidgetArea, this->statsDock);
+    this->statsDock->hide();
+    QObject::connect(this->statsDock, &QDockWidget::visibilityChanged, ui->cbStats, &QCheckBox::setChecked);
+    QObject::connect(this->statsShow, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::updateStats);
+    QObject::connect(this->monitor, &FaMonitor::updated, this, &MainWindow::updateStats);
+
+    // Waterfall of the log-f spectrum, "waterfall_depth" rows deep.
+    this->waterfall = new WaterfallView(qMax(1, object.value("waterfall_depth").toInt(FA_WATERFALL_DEPTH)), this);
+    this->waterfall->setRange(object.value("waterfall_range").toArray().at(0).toDouble(FA_WATERFALL_LOW),
+                              object.value("waterfall_range").toArray().at(1).toDouble(FA_WATERFALL_HIGH));
+    this->waterfallDock = new QDockWidget("Waterfall", this);
+    this->waterfallDock->setWidget(this->waterfall);
+    this->addDockWidget(Qt::BottomDockWidgetArea, this->waterfallDock);
+    this->waterfallDock->hide();
+    QObject::connect(this->waterfallDock, &QDockWidget::visibilityChanged, ui->cbWaterfall, &QCheckBox::setChecked);
 
-        ui->cbCells->addItem("Cell " + QString::number(cell));
-        QStringList subIDs = this->bpmIDs.filter(QString::asprintf("C%02d", cell));
-        for(QString item : subIDs) {
-            id = QString().asprintf(this->format.toStdString().c_str(), cell, currentID, subIDs.indexOf(item) + 1);
-            this->idsMap.insert(id, currentID++);
-        }
-    }
+    //
+    // Ring spectra: the spectrum of every BPM as one image row, refreshed
+    // by the monitor once a second while shown.
+    //
+    auto heatmapPanel = new QWidget(this);
+    auto heatmapLayout = new QVBoxLayout(heatmapPanel);
+    this->heatmapShow = new QComboBox(heatmapPanel);
+    this->heatmapShow->addItems({"X", "Y"});
+    this->heatmap = new HeatmapView(heatmapPanel);
+    heatmapLayout->setContentsMargins(0, 0, 0, 0);
+    heatmapLayout->addWidget(this->heatmapShow);
+    heatmapLayout->addWidget(this->heatmap);
+    this->heatmapDock = new QDockWidget("Ring spectra", this);
+    this->heatmapDock->setWidget(heatmapPanel);
+    this->addDockWidget(Qt::BottomDockWidgetArea, this->heatmapDock);
+    this->heatmapDock->hide();
+    QObject::connect(this->heatmapDock, &QDockWidget::visibilityChanged, ui->cbHeatmap, &QCheckBox::setChecked);
+    QObject::connect(this->heatmapShow, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::updateHeatmap);
+    QObject::connect(this->monitor, &FaMonitor::heatmapUpdated, this, &MainWindow::updateHeatmap);
+
+    //
+    // The grid takes the plot's place: a cell, or the BPMs picked as ids
+    // and ranges ("1-8, 12"), as traces or spectra.
+    //
+    this->gridPanel = new QWidget(ui->plot);
+    auto gridLayout = new QVBoxLayout(this->gridPanel);
+    auto gridControls = new QHBoxLayout;
+    this->gridSet = new QComboBox(this->gridPanel);
+    this->gridSet->addItem("Picked");
+    this->gridPicked = new QLineEdit(this->gridPanel);
+    this->gridPicked->setPlaceholderText("BPM ids, e.g. 1-8, 12");
+    this->gridShow = new QComboBox(this->gridPanel);
+    this->gridShow->addItems({"Traces", "Spectra"});
+    this->gridWindow = new QLabel(this->gridPanel);
+    this->grid = new GridView(this->acquisition, this->gridPanel);
+    gridControls->addWidget(this->gridSet);
+    gridControls->addWidget(this->gridPicked);
+    gridControls->addWidget(this->gridShow);
+    gridControls->addWidget(this->gridWindow);
+    gridLayout->setContentsMargins(0, 0, 0, 0);
+    gridLayout->addLayout(gridControls);
+    gridLayout->addWidget(this->grid);
+    ui->plot->layout()->addWidget(this->gridPanel);
+    this->gridPanel->hide();
+    QObject::connect(this->gridSet, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::updateGrid);
+    QObject::connect(this->gridPicked, &QLineEdit::editingFinished, this, &MainWindow::updateGrid);
+    QObject::connect(this->gridShow, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::updateGrid);
+    QObject::connect(this->grid, &GridView::bpmSelected, this, &MainWindow::onGridSelected);
+    QObject::connect(this->monitor, &FaMonitor::captured, this, &MainWindow::onCaptured);
 
-    this->resetLogFilter = true;
+    //
+    // Nothing here waits on the network: name lookups, CF queries and the
+    // first subscription run on the acquisition loop, the CL lists are
+    // queried in the background and the cached ones are used meanwhile.
+    //
+    this->acquisition->start();
+    this->monitor->start();
+    this->bpmIDs = this->acquisition->cachedBPMs();
+    buildIndex();
+    this->acquisition->refreshBPMs();
+
+    QObject::connect(ui->cbWindow, &QCheckBox::toggled, this, &MainWindow::updateConfig);
+    QObject::connect(ui->cbSquared, &QCheckBox::toggled, this, &MainWindow::updateConfig);
+    QObject::connect(ui->cbFilter, &QCheckBox::toggled, this, &MainWindow::updateConfig);
+    QObject::connect(ui->cbLinear, &QCheckBox::toggled, this, &MainWindow::updateConfig);
+    QObject::connect(ui->cbReverse, &QCheckBox::toggled, this, &MainWindow::updateConfig);
+    QObject::connect(ui->cbMultirate, &QCheckBox::toggled, this, &MainWindow::updateConfig);
+    QObject::connect(ui->cbZoom, &QCheckBox::toggled, this, &MainWindow::updateConfig);
+    QObject::connect(ui->cbModeSpectrum, &QCheckBox::toggled, this, &MainWindow::updateConfig);
+    QObject::connect(ui->cbPhase, &QCheckBox::toggled, this, &MainWindow::updateConfig);
+    QObject::connect(traceView, &TraceView::bandSelected, this, &MainWindow::onBandSelected);
+    QObject::connect(traceView, &TraceView::frozen, this, &MainWindow::freeze);
+    QObject::connect(traceView, &TraceView::rangeChanged, this, &MainWindow::onRangeChanged);
+
+    this->frozenPending = false;
+    this->frozenWatcher = new QFutureWatcher<bool>(this);
+    QObject::connect(this->frozenWatcher, &QFutureWatcher<bool>::finished, this, &MainWindow::onFrozenRendered);
+
+    this->zoomGeneration = 0;
+    this->zoomSeedGeneration = 0;
+    this->zoomSeedEnd = 0;
+    this->zoomWatcher = new QFutureWatcher<std::shared_ptr<fa::zoom>>(this);
+    QObject::connect(this->zoomWatcher, &QFutureWatcher<std::shared_ptr<fa::zoom>>::finished, this, &MainWindow::onZoomSeeded);
 
     ui->cbCells->setCurrentIndex(1);
     ui->cbTime->setCurrentIndex(3);
     ui->cbSignal->setCurrentText(0);
     on_cbSignal_currentIndexChanged(0);
-    readFrequency();
     reconnectToServer();
     installEventFilter(this);
 }
 
 MainWindow::~MainWindow()
 {
-    ::close(sock);
+    // The monitor's workers read the acquisition's buses.
+    this->monitor->stop();
+    this->frozenWatcher->waitForFinished();
+    this->zoomWatcher->waitForFinished();
     delete ui;
 }
 
 void MainWindow::pollServer()
 {
-    int i = 0;
-    int decimation_factor = 1;
-    int32_t raw_x = 0;
-    int32_t raw_y = 0;
-    float value_x;
-    float value_y;
-    float min = std::numeric_limits<float>::max();;
-    float max = std::numeric_limits<float>::min();;
-    char data[MAX_BUFFER_SIZE];
-    QVector<QPointF> xData;
-    QVector<QPointF> yData;
-    std::vector<float> fft_x;
-    std::vector<float> fft_y;
-    struct pollfd fds[1];
-    int status;
-
-    if (!chartView->m_isRunning) {
-        timer->stop();
-        return;
-    }
+    fa::bus* source;
+    const int32_t* samples;
+    size_t count;
 
-    this->x_series->clear();
-    this->y_series->clear();
-
-    fds[0].fd = this->sock;
-    fds[0].events = POLLIN;
-    fds[0].revents = 0;
-    status = ::poll(fds, 1, 1000 * this->timerPeriod);
-    if(status <= 0 && errno != 0 && errno != EINPROGRESS)
-    {
-        this->statusBar()->showMessage( QString::asprintf("FA Server disconnected. Code %d: %s", errno, strerror(errno)) );
-        ::close(this->sock);
+    if(this->bus.attached() && this->bus.stale()) {
+        this->statusBar()->showMessage("FA bus stopped, connecting to the server ...");
+        this->bus.detach();
+        reconnectToServer();
         return;
     }
 
-    this->statusBar()->showMessage("FA Server Running ...");
-    ssize_t bytes = read(sock, data, std::min<int>(MAX_BUFFER_SIZE, bufferSize));
-    for (i = 0; bytes > 27 && i < bytes; i += 8) {
-        memcpy(&raw_x, data + i, sizeof(int32_t));
-        memcpy(&raw_y, data + i + 4, sizeof(int32_t));
+    source = this->bus.attached() ? &this->bus : this->acquisition->bus(this->currentID);
+    if(!source)
+        return;
 
-        value_x = (raw_x) / 1000.0;
-        value_y = (raw_y) / 1000.0;
-        bufferX.push_back(value_x);
-        bufferY.push_back(value_y);
+    samples = source->fetch(this->busSequence, count);
+    ingest((const char*) samples, count * 2 * sizeof(int32_t));
+    if(source->frequency() > 0 && source->frequency() != this->samplingFrequency) {
+        this->samplingFrequency = source->frequency();
+        this->historyX.set_capacity(size_t(this->historyTime * this->samplingFrequency));
+        this->historyY.set_capacity(size_t(this->historyTime * this->samplingFrequency));
+        setGridWindow();
     }
+    if(count > 0)
+        this->statusBar()->showMessage((this->bus.attached() ? "FA Bus Running ..." : "FA Server Running ...") + this->startupReport);
+}
 
-    int xIndex = std::min<int>(this->samples, bufferX.size());
-    int yIndex = std::min<int>(this->samples, bufferY.size());
-    std::vector<float> data_x(this->samples - xIndex, 0);
-    std::vector<float> data_y(this->samples - yIndex, 0);
-    std::copy(bufferX.end() - xIndex, bufferX.end(), std::back_inserter(data_x));
-    std::copy(bufferY.end() - yIndex, bufferY.end(), std::back_inserter(data_y));
+void MainWindow::onFrame()
+{
+    QElapsedTimer clock;
 
-    auto compare_zero = [](float i){ return i == 0.0; };
-    auto square = [](float a){ return a * a; };
-    auto sum = [](float a, float b) { return a*a + b; };
+    // The monitor's results are taken in on this thread too, between frames.
+    double monitored = this->monitor->takeCost();
 
-    if(std::all_of(data_x.begin(), data_x.end(), compare_zero) &&
-       std::all_of(data_y.begin(), data_y.end(), compare_zero)) {
-        if(!this->chart->title().endsWith("(NC)"))
-            this->chart->setTitle(this->chart->title() + " (NC)");
+    //
+    // Minimised or covered, only the acquisition goes on: the rings and the
+    // history keep filling and the next exposed frame analyses the newest
+    // window. The same while neither the chart nor the waterfall is shown.
+    //
+    bool exposed = this->windowHandle() && this->windowHandle()->isExposed() && !this->isMinimized();
+    this->monitor->setIdle(!exposed);
+    if(!exposed || (!this->traceView->isVisible() && !this->waterfallDock->isVisible()))
         return;
-    }
-
-    if(ui->cbSignal->currentIndex() == MODE_FFT_LOGF) {
-        std::vector<float> fft_raw_x;
-        std::vector<float> fft_raw_y;
-        computeFFT(data_x, data_y, fft_raw_x, fft_raw_y);
-        std::transform(fft_raw_x.begin(), fft_raw_x.end(), fft_raw_x.begin(), square);
-        std::transform(fft_raw_y.begin(), fft_raw_y.end(), fft_raw_y.begin(), square);
-
-        std::vector<int> gaps(this->samples / 2, 0);
-        std::vector<int> diffs;
-        double delta = pow(10, log10(this->samples/2 - 2)/(this->samples / 2 - 1));
 
-        int i = 0;
-        std::transform(gaps.begin(), gaps.end(), gaps.begin(), [delta, &i](int a) { Q_UNUSED(a); return pow(delta, i++); });
-
-        i = 0;
-        std::for_each(gaps.begin() + 1, gaps.end(), [&](int a) { int diff = a - *(gaps.begin() + i++); if ( diff > 0) diffs.push_back(diff); });
+    // Frozen, the stream keeps filling the history and the view stays on the snapshot.
+    if(!traceView->m_isRunning || !this->timer->isActive())
+        return;
 
-//        std::transform(gaps.begin(), gaps.end(), gaps.begin() + 1, std::back_inserter(_diffs), [](int a, int b) { return b - a; });
-//        std::for_each(_diffs.begin(), _diffs.end(), [&](int a) { if (a > 0) diffs.push_back(a);});
+    clock.start();
+    render();
+    pace(clock.nsecsElapsed() / 1e6 + monitored);
+}
 
-//        for(int i = 0; i < (this->samples / 2); i++) {
-//            gaps.push_back(pow(delta, i));
-//        }
+void MainWindow::pace(double cost)
+{
+    //
+    // The analysis, with what the monitor took in since the last frame, may
+    // take FA_FRAME_BUDGET of its period on the GUI thread.
+    // Over that the period doubles, up to FA_FRAME_SLOWDOWN times the
+    // window's own; well under it, it comes back. The cost is smoothed so
+    // one slow tick does not change the rate.
+    //
+    int target = this->timerPeriod;
+    int period = this->frameTimer->interval();
+    this->analysisCost = this->analyses == 0 ? cost : 0.8 * this->analysisCost + 0.2 * cost;
+    if(this->analysisCost > FA_FRAME_BUDGET * period && period < target * FA_FRAME_SLOWDOWN)
+        period *= 2;
+    else if(this->analysisCost < FA_FRAME_BUDGET / 4 * period && period > target)
+        period = qMax(target, period / 2);
+    this->frameTimer->setInterval(period);
+    this->analyses++;
+
+    if(this->rateClock.elapsed() < 1000)
+        return;
 
-//        for(size_t i = 1; i < gaps.size(); i++) {
-//            int diff = gaps[i] - gaps[i - 1];
-//            if(diff > 0) {
-//                diffs.push_back(diff);
-//            }
-//        }
+    double seconds = this->rateClock.restart() / 1000.0;
+    int frames = this->traceView->frames();
+    this->rateLabel->setText(QString::asprintf("Analysis %.1f Hz (%.0f ms%s), display %.1f fps (%.0f ms)",
+                                               this->analyses / seconds, this->analysisCost, period > target ? ", slowed" : "",
+                                               (frames - this->displayed) / seconds, this->traceView->frameCost()));
+    this->analyses = 0;
+    this->displayed = frames;
+}
 
-        int start = 0;
-        int step = 0;
-        std::vector<float>::iterator condense_x = fft_raw_x.begin();
-        std::vector<float>::iterator condense_y = fft_raw_y.begin();
-        for(unsigned i = 0; i < diffs.size(); i++) {
-            step = diffs[i];
+bool MainWindow::analyseWindow()
+{
+    const fa::analysis_config& config = this->analysis.config();
+    std::vector<float>& data_x = this->windowX;
+    std::vector<float>& data_y = this->windowY;
+    if(config.zoom > 0) {
+        data_x.resize(2 * FA_ZOOM_LENGTH);
+        data_y.resize(2 * FA_ZOOM_LENGTH);
+        this->zoom.read(0, data_x.data());
+        this->zoom.read(1, data_y.data());
+    }
+    else if(config.mode == MODE_RAW && config.ratio > 1) {
+        data_x.resize(this->samples / config.ratio);
+        data_y.resize(this->samples / config.ratio);
+        this->decimatorX.read(config.ratio, data_x.data(), data_x.size());
+        this->decimatorY.read(config.ratio, data_y.data(), data_y.size());
+    }
+    else if(config.multirate) {
+        //
+        // The full-rate level, then every decimated one that has filled up.
+        //
+        int levels = 1;
+        int ratio = 10;
+        while(levels < FA_MULTIRATE_LEVELS && this->decimatorX.size(ratio) >= FA_MULTIRATE_LENGTH) {
+            levels++;
+            ratio *= 10;
+        }
 
-            // xData.push_back( QPointF(i + 1, sqrt( std::accumulate(condense_x + start, condense_x + start + step, 0.0) ) ) );
-            // yData.push_back( QPointF(i + 1, sqrt( std::accumulate(condense_y + start, condense_y + start + step, 0.0) ) ) );
-            fft_x.push_back(std::sqrt( std::accumulate(condense_x + start, condense_x + start + step, 0.0) ));
-            fft_y.push_back(std::sqrt( std::accumulate(condense_y + start, condense_y + start + step, 0.0) ));
+        data_x.resize(levels * FA_MULTIRATE_LENGTH);
+        data_y.resize(levels * FA_MULTIRATE_LENGTH);
+        readWindow(bufferX, historyX, data_x.data(), FA_MULTIRATE_LENGTH);
+        readWindow(bufferY, historyY, data_y.data(), FA_MULTIRATE_LENGTH);
+        for(int j = 1, ratio = 10; j < levels; j++, ratio *= 10) {
+            this->decimatorX.read(ratio, data_x.data() + j * FA_MULTIRATE_LENGTH, FA_MULTIRATE_LENGTH);
+            this->decimatorY.read(ratio, data_y.data() + j * FA_MULTIRATE_LENGTH, FA_MULTIRATE_LENGTH);
+        }
+    }
+    else {
+        data_x.resize(this->samples);
+        data_y.resize(this->samples);
+        readWindow(bufferX, historyX, data_x.data(), data_x.size());
+        readWindow(bufferY, historyY, data_y.data(), data_y.size());
+    }
 
-            start += step;
+    auto compare_zero = [](float i){ return i == 0.0; };
 
-            // std::tie(min, max) = calculateLimits(xData.last().y(), yData.last().y(), min, max);
-        }
+    if(std::all_of(data_x.begin(), data_x.end(), compare_zero) &&
+       std::all_of(data_y.begin(), data_y.end(), compare_zero)) {
+        this->traceView->clear();
+        if(!this->traceView->title().endsWith("(NC)"))
+            this->traceView->setTitle(this->traceView->title() + " (NC)");
+        return false;
+    }
 
-        if (ui->cbFilter->isChecked()) {
-            std::vector<float> p_sum = std::vector<float>(diffs.size(), 0);
-            std::partial_sum(diffs.begin(), diffs.end(), p_sum.begin());
-            std::transform(p_sum.begin(), p_sum.end(), p_sum.begin(), [this](float a) { return this->samplingFrequency * a / this->samples; });
-            std::transform(fft_x.begin(), fft_x.end(), p_sum.begin(), fft_x.begin(), std::multiplies<float>());
-            std::transform(fft_y.begin(), fft_y.end(), p_sum.begin(), fft_y.begin(), std::multiplies<float>());
-        }
+    //
+    // The kernel was chosen when the settings last changed, nothing below
+    // looks at the widgets.
+    //
+    this->analysis.set_frequency(this->samplingFrequency);
+    this->analysis.run(this->currentID, this->historyX.end(), data_x, data_y, this->trace);
+    return true;
+}
 
-        // fft_logf is "self.history"
-        if(this->logFilter == 1) {
-            // Do nothing, return FFT as it is.
-        }
-        else if(this->resetLogFilter) {
-            this->resetLogFilter = false;
-            fft_logf_x = std::vector<float>(fft_x.size(), 0);
-            fft_logf_y = std::vector<float>(fft_y.size(), 0);
-            std::transform(fft_x.begin(), fft_x.end(), fft_logf_x.begin(), square);
-            std::transform(fft_y.begin(), fft_y.end(), fft_logf_y.begin(), square);
-        }
-        else {
-            std::transform(fft_x.begin(), fft_x.end(), fft_logf_x.begin(), fft_x.begin(),
-                           [this] (float a, float b) { return std::sqrt(this->logFilter * a * a + (1 - this->logFilter) * b); });
-            std::transform(fft_y.begin(), fft_y.end(), fft_logf_y.begin(), fft_y.begin(),
-                           [this] (float a, float b) { return std::sqrt(this->logFilter * a * a + (1 - this->logFilter) * b); });
-        }
+void MainWindow::render()
+{
+#ifdef FA_COUNT_ALLOCATIONS
+    size_t allocations = fa::allocations();
+    size_t library = fa::library_allocations();
+#endif
 
-        for(int i = 1; i < qMin<int>(fft_x.size(), fft_y.size()); i++) {
-            xData.push_back(QPointF(i, fft_x[i]));
-            yData.push_back(QPointF(i, fft_y[i]));
-            std::tie(min, max) = calculateLimits(xData.last().y(), yData.last().y(), min, max);
+    //
+    // Everything from here to the plot is reused across ticks: the windows,
+    // the analysis scratch and the plot's copy of the trace.
+    //
+    const fa::analysis_config& config = this->analysis.config();
+    fa::orbit_svd& orbit = this->monitor->orbit();
+    size_t mode = config.decimation;
+    if(config.mode == MODE_ORBIT) {
+        if(!orbit.ready() || mode >= orbit.modes()) {
+            this->traceView->clear();
+            return;
         }
-
-        modifyAxes({xLogAxis, yLogAxis}, {xAxis, yAxis}, {1, diffs.size()}, {min, max}, {"Frequency (Hz)", "Amplitude (um/√Hz)"});
+        if(config.orbitSpectrum)
+            orbit.density(mode, this->trace);
+        else
+            orbit.shape(mode, this->trace);
     }
-    else if(ui->cbSignal->currentIndex() == MODE_FFT) {
-        if(ui->cbDecimation->currentIndex() == FFT_1_1) {
-            fft_x.reserve(data_x.size() / 2);
-            fft_y.reserve(data_y.size() / 2);
-            computeFFT(data_x, data_y, fft_x, fft_y);
+    else if(config.mode == MODE_COHERENCE) {
+        int against = config.decimation == COHERENCE_XY ? this->currentID : config.decimation;
+        bool ready = config.decimation == COHERENCE_SCAN ? this->monitor->coherenceScan(this->currentID, this->trace)
+                                                         : this->monitor->coherence(this->currentID, against, config.phase, this->trace);
+        if(!ready || this->trace.index.empty()) {
+            this->traceView->clear();
+            return;
         }
-        else { // FFT_10_1
-            decimation_factor = 10;
-            int decimation = this->samples / decimation_factor;
-            std::vector<float> sum_x(decimation / 2, 0);
-            std::vector<float> sum_y(decimation / 2, 0);
-            std::vector<float> fft_mag_x;
-            std::vector<float> fft_mag_y;
-
-            for(int i = 0; i < this->samples; i += decimation) {
-                std::vector<float> sub_x(data_x.begin() + i, data_x.begin() + i + decimation);
-                std::vector<float> sub_y(data_y.begin() + i, data_y.begin() + i + decimation);
-
-                computeFFT(sub_x, sub_y, fft_mag_x, fft_mag_y);
-                std::transform(fft_mag_x.begin(), fft_mag_x.end(), sum_x.begin(), sum_x.begin(), sum);
-                std::transform(fft_mag_y.begin(), fft_mag_y.end(), sum_y.begin(), sum_y.begin(), sum);
-            }
+    }
+    else if(!analyseWindow()) {
+        return;
+    }
 
-            std::transform(std::begin(sum_x), std::end(sum_x), std::back_inserter(fft_x), [](float item) { return std::sqrt(item / 10.0); });
-            std::transform(std::begin(sum_y), std::end(sum_y), std::back_inserter(fft_y), [](float item) { return std::sqrt(item / 10.0); });
-        }
+    present(config);
 
-        for(int i = 0; i < (int)fft_x.size(); i++) {
-            xData.push_back(QPointF(i * decimation_factor, ui->cbSquared->isChecked() ? square(fft_x[i]) : fft_x[i]));
-            yData.push_back(QPointF(i * decimation_factor, ui->cbSquared->isChecked() ? square(fft_y[i]) : fft_y[i]));
-            std::tie(min, max) = calculateLimits(xData.last().y(), yData.last().y(), min, max);
-        }
+    // The waterfall follows the shown plane, Y only when X is hidden.
+    if(config.mode == MODE_FFT_LOGF && this->waterfallDock->isVisible())
+        this->waterfall->append(ui->cbShow->currentIndex() == 2 ? this->trace.y : this->trace.x);
 
-        modifyAxes({xAxis, yLogAxis}, {xLogAxis, yAxis}, {0, this->samples / 2}, {min, max}, {"Frequencies (Hz)", ui->cbSquared->isChecked() ? "Amplitudes (um^2/Hz)" : "Amplitude (um/√Hz)"});
+#ifdef FA_COUNT_ALLOCATIONS
+    //
+    // Once the cache has filled, the first tick sets how much the library
+    // calls may allocate and every later one must stay within it. Ticks
+    // under the pointer format the tooltip text and are not checked.
+    //
+    allocations = fa::allocations() - allocations;
+    library = fa::library_allocations() - library;
+    if(this->steadyTicks++ == FA_SPECTRUM_CACHE)
+        this->libraryBudget = library;
+    if(this->steadyTicks > FA_SPECTRUM_CACHE && !traceView->m_isMouseOver &&
+       (allocations > 0 || library > this->libraryBudget))
+        qFatal("Steady-state refresh tick allocated %zu times, and %zu times in library calls (budget %zu)",
+               allocations, library, this->libraryBudget);
+#endif
+
+    if(!this->firstTrace) {
+        this->firstTrace = true;
+        this->startupReport = QString::asprintf(" (first trace %lld ms after start)", this->startup.elapsed());
     }
-    else if(ui->cbSignal->currentIndex() == MODE_INTEGRATED)
-    {
-        std::vector<float> fft_raw_x;
-        std::vector<float> fft_raw_y;
-        std::vector<int> gaps;
-        std::vector<int> diffs;
-        double delta = pow(10, log10(this->samples/2 - 2)/(this->samples / 2 - 1));
-        for(int i = 0; i < (this->samples / 2) - 1; i++) {
-            gaps.push_back(pow(delta, i));
-        }
+}
 
-        for(size_t i = 1; i < gaps.size(); i++) {
-            int diff = gaps[i] - gaps[i - 1];
-            if(diff > 0) {
-                diffs.push_back(diff);
-            }
-        }
+void MainWindow::present(const fa::analysis_config& config)
+{
+    fa::orbit_svd& orbit = this->monitor->orbit();
+    size_t mode = config.decimation;
 
-        computeFFT(data_x, data_y, fft_raw_x, fft_raw_y);
-        std::transform(fft_raw_x.begin(), fft_raw_x.end(), fft_raw_x.begin(), square);
-        std::transform(fft_raw_y.begin(), fft_raw_y.end(), fft_raw_y.begin(), square);
+    //
+    // The log-f and integrated x axes count bins, except for the multi-rate
+    // spectrum which is already in Hz.
+    //
+    std::tuple<float, float> bins = {1, this->trace.bins};
+    if(config.multirate && !this->trace.index.empty())
+        bins = {this->trace.index.front(), this->trace.index.back()};
 
-        int start = 0;
-        int step = 0;
-        std::vector<float>::iterator condense_x = fft_raw_x.begin() + 2;
-        std::vector<float>::iterator condense_y = fft_raw_y.begin() + 2;
-        for(unsigned i = 0; i < diffs.size(); i++) {
-            step = diffs[i];
+    //
+    // Orbit mode shapes and the coherence scan tick at every cell
+    // boundary, BPMs being in cell order.
+    //
+    int ticks = 6;
+    bool ring = (config.mode == MODE_ORBIT && !config.orbitSpectrum) || (config.mode == MODE_COHERENCE && config.decimation == COHERENCE_SCAN);
+    if(ring && this->bpms > 0 && this->trace.index.size() % this->bpms == 0)
+        ticks = this->trace.index.size() / this->bpms + 1;
+    this->traceView->setTickCount(ticks);
+
+    // Formatted in place, a QString per tick would allocate.
+    char title[TRACE_TITLE_LENGTH];
+    if(config.mode == MODE_ORBIT && config.orbitSpectrum)
+        qsnprintf(title, sizeof(title), "Mode %d (um/√Hz)", int(mode + 1));
+    else if(config.mode == MODE_ORBIT)
+        qsnprintf(title, sizeof(title), "Mode %d, %.3f / %.3f um rms", int(mode + 1), orbit.strength(0, mode), orbit.strength(1, mode));
+
+    if(config.mode == MODE_ORBIT && config.orbitSpectrum)
+        modifyAxes(true, true, {this->trace.index.front(), this->trace.index.back()}, {this->trace.min, this->trace.max},
+                   "Frequency (Hz)", title);
+    else if(config.mode == MODE_ORBIT)
+        modifyAxes(false, false, {0, orbit.bpms()}, {this->trace.min, this->trace.max},
+                   "BPM (cell order)", title);
+    else if(config.mode == MODE_COHERENCE && config.decimation == COHERENCE_SCAN)
+        modifyAxes(false, false, {0, this->trace.index.size()}, {0, 1}, "BPM (cell order)", "Band coherence");
+    else if(config.mode == MODE_COHERENCE && config.phase)
+        modifyAxes(true, false, {this->trace.index.front(), this->trace.index.back()}, {-180, 180}, "Frequency (Hz)", "Phase (deg)");
+    else if(config.mode == MODE_COHERENCE)
+        modifyAxes(true, false, {this->trace.index.front(), this->trace.index.back()}, {0, 1}, "Frequency (Hz)", "Coherence");
+    else if(config.mode == MODE_FFT && config.zoom > 0)
+        modifyAxes(false, true, {config.bandLow, config.bandHigh}, {this->trace.min, this->trace.max}, "Frequency (Hz)", config.squared ? "Amplitudes (um^2/Hz)" : "Amplitude (um/√Hz)");
+    else if(config.mode == MODE_FFT_LOGF)
+        modifyAxes(true, true, bins, {this->trace.min, this->trace.max}, "Frequency (Hz)", "Amplitude (um/√Hz)");
+    else if(config.mode == MODE_FFT)
+        modifyAxes(false, true, {0, this->samples / 2}, {this->trace.min, this->trace.max}, "Frequencies (Hz)", config.squared ? "Amplitudes (um^2/Hz)" : "Amplitude (um/√Hz)");
+    else if(config.mode == MODE_INTEGRATED && config.linear)
+        modifyAxes(true, false, bins, {this->trace.min, this->trace.max}, "Frequency (Hz)", "Cumulative Amplitude (um)");
+    else if(config.mode == MODE_INTEGRATED)
+        modifyAxes(true, true, bins, {this->trace.min, this->trace.max}, "Frequency (Hz)", "Cumulative Amplitude (um)");
+    else if(this->frozen && !traceView->m_isRunning)
+        modifyAxes(false, false, this->frozenRange, {this->trace.min, this->trace.max}, "Time (ms)", "Positions (um)");
+    else
+        modifyAxes(false, false, {0, this->samples / 10.0}, {this->trace.min, this->trace.max}, "Time (ms)", "Positions (um)");
 
-            // xData.push_back( QPointF(i + 1, sqrt( std::accumulate(condense_x + start, condense_x + start + step, 0.0) ) ) );
-            // yData.push_back( QPointF(i + 1, sqrt( std::accumulate(condense_y + start, condense_y + start + step, 0.0) ) ) );
-            fft_x.push_back( std::accumulate(condense_x + start, condense_x + start + step, 0.0) );
-            fft_y.push_back( std::accumulate(condense_y + start, condense_y + start + step, 0.0) );
+    this->traceView->setTrace(this->trace);
 
-            start += step;
+    if (traceView->m_isMouseOver)
+        displayTooltip();
+    else
+        QToolTip::hideText();
 
-            // std::tie(min, max) = calculateLimits(xData.last().y(), yData.last().y(), min, max);
-        }
+//    delete[] data;
+}
 
-        size_t N = qMin<size_t>(data_x.size(), data_y.size());
-        std::vector<float> sum_x(fft_x.size(), 0);
-        std::vector<float> sum_y(fft_y.size(), 0);
+void MainWindow::ingest(const char *data, size_t bytes)
+{
+    int32_t raw_x = 0;
+    int32_t raw_y = 0;
+    float value_x;
+    float value_y;
 
-        if (ui->cbReverse->isChecked()) {
-            std::reverse(fft_x.begin(), fft_x.end());
-            std::reverse(fft_y.begin(), fft_y.end());
-        }
+    for (size_t i = 0; i + 8 <= bytes; i += 8) {
+        memcpy(&raw_x, data + i, sizeof(int32_t));
+        memcpy(&raw_y, data + i + 4, sizeof(int32_t));
+
+        value_x = (raw_x) / 1000.0;
+        value_y = (raw_y) / 1000.0;
+        bufferX.push_back(value_x);
+        bufferY.push_back(value_y);
+        historyX.push_back(raw_x);
+        historyY.push_back(raw_y);
+        decimatorX.push_back(raw_x);
+        decimatorY.push_back(raw_y);
+        zoom.push_back(raw_x, raw_y);
+    }
+}
 
-        std::partial_sum(fft_x.begin(), fft_x.end(), sum_x.begin());
-        std::partial_sum(fft_y.begin(), fft_y.end(), sum_y.begin());
+void MainWindow::buildIndex()
+{
+    QVector<QStringList> cellIDs(this->cells + 1);
+    QString id;
+    int currentID = this->firstID;
 
-        if (ui->cbReverse->isChecked()) {
-            std::reverse(sum_x.begin(), sum_x.end());
-            std::reverse(sum_y.begin(), sum_y.end());
+    //
+    // A single pass files every name under each cell whose "Cnn" tag it
+    // carries, in CL order.
+    //
+    for(const QString& name : this->bpmIDs) {
+        for(int i = 0; i + 2 < name.size(); i++) {
+            if(name[i] != 'C' || !name[i + 1].isDigit() || !name[i + 2].isDigit())
+                continue;
+
+            int cell = name[i + 1].digitValue() * 10 + name[i + 2].digitValue();
+            if(cell >= 1 && cell <= this->cells && (cellIDs[cell].isEmpty() || cellIDs[cell].last() != name))
+                cellIDs[cell].push_back(name);
         }
+    }
 
-        std::transform(sum_x.begin(), sum_x.end(), sum_x.begin(), [this, N](float a) { return std::sqrt(this->samplingFrequency / N * a); });
-        std::transform(sum_y.begin(), sum_y.end(), sum_y.begin(), [this, N](float a) { return std::sqrt(this->samplingFrequency / N * a); });
+    this->idsMap.clear();
+    this->namesMap.clear();
+    this->cellsMap.clear();
+    while(ui->cbCells->count() > 1)
+        ui->cbCells->removeItem(ui->cbCells->count() - 1);
+    this->gridSet->blockSignals(true);
+    while(this->gridSet->count() > 1)
+        this->gridSet->removeItem(this->gridSet->count() - 1);
+    this->gridSet->blockSignals(false);
 
-        for(int i = 1; i < qMin<int>(sum_x.size(), sum_y.size()); i++) {
-            xData.push_back(QPointF(i, sum_x[i]));
-            yData.push_back(QPointF(i, sum_y[i]));
-            std::tie(min, max) = calculateLimits(xData.last().y(), yData.last().y(), min, max);
-        }
+    for(int cell = 1; cell <= this->cells; cell++) {
+        if(currentID > this->ids)
+            break;
 
-        if (ui->cbLinear->isChecked()) {
-            modifyAxes({xLogAxis, yAxis}, {xAxis, yLogAxis}, {1, diffs.size()}, {min, max}, {"Frequency (Hz)", "Cumulative Amplitude (um)"});
-        }
-        else {
-            modifyAxes({xLogAxis, yLogAxis}, {xAxis, yAxis}, {1, diffs.size()}, {min, max}, {"Frequency (Hz)", "Cumulative Amplitude (um)"});
+        ui->cbCells->addItem("Cell " + QString::number(cell));
+        this->gridSet->addItem("Cell " + QString::number(cell));
+        for(int i = 0; i < cellIDs[cell].size(); i++) {
+            id = QString().asprintf(this->format.toStdString().c_str(), cell, currentID, i + 1);
+            this->idsMap.insert(id, currentID);
+            this->cellsMap.insert(currentID, {cell, i});
+            this->namesMap.insert(currentID++, id);
         }
     }
-    else {
-        float item_x;
-        float item_y;
-        float sum_x = 0;
-        float sum_y = 0;
-        int index;
-
-        for(unsigned i = 0; i < qMin(data_x.size(), data_y.size()); i++) {
-            if(ui->cbDecimation->currentIndex() == DECIMATION_1_1) {
-                item_x = data_x[i];
-                item_y = data_y[i];
-                index = i;
-            }
-            else if(ui->cbDecimation->currentText() == "100:1") {
-                if(i == 0 || i % 100 != 0) {
-                    sum_x += data_x[i];
-                    sum_y += data_y[i];
-                    continue;
-                }
-                // index = i / 100 - 1;
-                index = i;
-                item_x = sum_x / 100.0;
-                item_y = sum_y / 100.0;
-                sum_x = 0;
-                sum_y = 0;
-            }
-            else { // DECIMATION_DIFF
-                if(i == 0)
-                    continue;
-                index = i - 1;
-                item_x = data_x[i] - data_x[i - 1];
-                item_y = data_y[i] - data_y[i - 1];
-            }
+}
 
-            xData.push_back(QPointF(index / 10.0, item_x));
-            yData.push_back(QPointF(index / 10.0, item_y));
-            std::tie(min, max) = calculateLimits(item_x, item_y, min, max);
-        }
+void MainWindow::onBPMListChanged(QStringList names)
+{
+    int cell = ui->cbCells->currentIndex();
+    QString current = ui->cbID->currentText();
 
-        modifyAxes({xAxis, yAxis}, {xLogAxis, yLogAxis}, {0, this->samples / 10.0}, {min, max}, {"Time (ms)", "Positions (um)"});
+    if(names.isEmpty()) {
+        this->statusBar()->showMessage("Could not read the BPM list from the FA servers.");
+        return;
     }
 
-    this->x_series->replace(xData);
-    this->y_series->replace(yData);
-    chartView->update();
+    if(this->idsMap.isEmpty()) {
+        this->bpmIDs = names;
+        buildIndex();
+        ui->cbCells->setCurrentIndex(1);
+        return;
+    }
 
-    if (chartView->m_isMouseOver)
-        displayTooltip();
-    else
-        QToolTip::hideText();
+    this->bpmIDs = names;
+    ui->cbCells->blockSignals(true);
+    buildIndex();
+    ui->cbCells->setCurrentIndex(qMin(cell, ui->cbCells->count() - 1));
+    ui->cbCells->blockSignals(false);
 
-//    delete[] data;
+    ui->cbID->blockSignals(true);
+    on_cbCells_currentIndexChanged(ui->cbCells->currentIndex());
+    ui->cbID->setCurrentText(current);
+    ui->cbID->blockSignals(false);
+
+    if(ui->cbID->isVisible() && ui->cbID->currentText() != current)
+        on_cbID_currentIndexChanged(ui->cbID->currentText());
 }
 
 void MainWindow::on_cbCells_currentIndexChanged(int index)
@@ -493,43 +662,196 @@ void MainWindow::on_cbID_currentIndexChanged(const QString &arg1)
 {
     int currentID;
 
-    this->chart->setTitle(arg1);
+    if(arg1.isEmpty())
+        return;
+
+    this->traceView->setTitle(arg1);
     currentID = this->idsMap[arg1];
-    this->message = "S" + QString::number(currentID) + "\n";
+    this->currentID = currentID;
     this->timer->stop();
-    ::close(this->sock);
+    clearHistory(arg1);
     reconnectToServer();
 }
 
 void MainWindow::reconnectToServer()
 {
-    char c;
+    //
+    // An acquisition daemon on this host already streams every BPM into
+    // shared memory, read from there instead of opening another subscription.
+    //
+    if(this->bus.attach(this->acquisition->sharedName(this->currentID))) {
+        this->acquisition->subscribe({});
+        this->busSequence = 0;
+    }
+    else if(this->monitor->active() || ui->cbGrid->isChecked()) {
+        // The ring monitors and the grid need every BPM streaming.
+        this->acquisition->subscribe(this->acquisition->configuredIDs());
+        this->streaming = true;
+        this->busSequence = this->acquisition->bus(this->currentID) ? this->acquisition->bus(this->currentID)->sequence() : 0;
+    }
+    else {
+        this->acquisition->subscribe({this->currentID});
+        this->streaming = false;
+        this->busSequence = this->acquisition->bus(this->currentID) ? this->acquisition->bus(this->currentID)->sequence() : 0;
+    }
 
-    initSocket();
-    ::write(sock, message.toStdString().c_str(), message.length());
-    ::read(sock, &c, 1);
+    traceView->m_isRunning = true;
+    this->frozen.reset();
+    this->frozenSource.reset();
+    this->timer->start();
+}
+
+void MainWindow::freeze()
+{
+    //
+    // The whole decodable history of this BPM, up to the longest window,
+    // becomes the snapshot the frozen view is zoomed and redrawn from while
+    // acquisition goes on filling the rings. Only the views of the
+    // compressed history and the newest, uncompressed samples are taken
+    // here; the first redraw decodes them on its worker.
+    //
+    auto data = std::make_shared<fa::snapshot>();
+    auto source = std::make_shared<fa::snapshot_source>();
+    size_t available = this->historyX.end() - this->historyX.begin();
+    size_t count = std::min<size_t>(FA_SNAPSHOT_TIME * this->samplingFrequency, std::max<size_t>(available, this->samples));
+    size_t hot = std::min<size_t>(count, bufferX.size());
+    uint64_t start = this->historyX.end() - std::min<uint64_t>(count, this->historyX.end());
+
+    data->bpm = this->currentID;
+    data->end = this->historyX.end();
+    data->frequency = this->samplingFrequency;
+    source->count = count;
+    source->x = this->historyX.view(start);
+    source->y = this->historyY.view(start);
+    source->hot_x.assign(bufferX.data() + bufferX.size() - hot, bufferX.data() + bufferX.size());
+    source->hot_y.assign(bufferY.data() + bufferY.size() - hot, bufferY.data() + bufferY.size());
+
+    this->frozen = std::move(data);
+    this->frozenSource = std::move(source);
+    this->frozenRange = {0, this->samples / 10.0};
+    renderFrozen();
+}
 
-    if (c != 0) {
-        this->statusBar()->showMessage("FA Server: No data currently available");
+void MainWindow::renderFrozen()
+{
+    //
+    // The ring-wide modes and the band zoom read their own live state, and
+    // are drawn as before. Everything else is redone from the snapshot on a
+    // worker; requests made while one runs collapse into a single rerun.
+    //
+    const fa::analysis_config& config = this->analysis.config();
+    if(!this->frozen || config.mode >= MODE_ORBIT || config.zoom > 0) {
+        render();
+        return;
+    }
+    if(this->frozenWatcher->isRunning()) {
+        this->frozenPending = true;
         return;
     }
 
-    chartView->m_isRunning = true;
-    this->timer->start();
+    // Runs are never concurrent, so only the first one writes the snapshot.
+    std::shared_ptr<fa::snapshot> data = this->frozen;
+    std::shared_ptr<const fa::snapshot_source> source = std::move(this->frozenSource);
+    std::tuple<float, float> range = this->frozenRange;
+    this->frozenSource.reset();
+    this->frozenPending = false;
+    this->frozenWatcher->setFuture(QtConcurrent::run([this, data, source, config, range]() {
+        if(source)
+            fa::fill(*data, *source);
+        return analyseSnapshot(*data, config, range);
+    }));
+}
+
+bool MainWindow::analyseSnapshot(const fa::snapshot& data, fa::analysis_config config, std::tuple<float, float> range)
+{
+    // The window shown live when the display froze ends the snapshot.
+    size_t length = std::min<size_t>(config.samples, data.x.size());
+    size_t first = data.x.size() - length;
+
+    if(config.mode == MODE_RAW) {
+        float spacing = 1000 / data.frequency;
+        size_t start = std::max(0.0f, std::get<0>(range) / spacing);
+        size_t stop = std::max(0.0f, std::ceil(std::get<1>(range) / spacing)) + 1;
+        fa::envelope(data, first, start, stop, FA_SNAPSHOT_POINTS, config.decimation == DECIMATION_DIFF, this->frozenTrace);
+        return !this->frozenTrace.index.empty();
+    }
+
+    //
+    // Spectra are taken over the full-rate window alone: the multi-rate
+    // levels come from decimator rings the snapshot does not keep.
+    //
+    config.multirate = false;
+    config.frequency = data.frequency;
+    this->frozenX.assign(data.x.begin() + first, data.x.end());
+    this->frozenY.assign(data.y.begin() + first, data.y.end());
+    if(config != this->frozenAnalysis.config())
+        this->frozenAnalysis.configure(config);
+    this->frozenAnalysis.set_frequency(data.frequency);
+    this->frozenAnalysis.run(data.bpm, data.end, this->frozenX, this->frozenY, this->frozenTrace);
+    return true;
+}
+
+void MainWindow::onFrozenRendered()
+{
+    // Resumed, or a newer request superseded this one.
+    if(!this->frozen || traceView->m_isRunning)
+        return;
+    if(this->frozenPending) {
+        renderFrozen();
+        return;
+    }
+    if(!this->frozenWatcher->result())
+        return;
+
+    std::swap(this->trace, this->frozenTrace);
+    present(this->analysis.config().mode == MODE_RAW ? this->analysis.config() : this->frozenAnalysis.config());
+}
+
+void MainWindow::onRangeChanged(qreal min, qreal max)
+{
+    // Only a zoom or pan over a frozen raw view asks for a finer redraw.
+    if(!this->frozen || traceView->m_isRunning || this->analysis.config().mode != MODE_RAW)
+        return;
+    if(std::get<0>(this->frozenRange) == float(min) && std::get<1>(this->frozenRange) == float(max))
+        return;
+
+    this->frozenRange = {min, max};
+    renderFrozen();
+}
+
+void MainWindow::onCaptured(int id, QString path, bool saved)
+{
+    QString name = this->namesMap.value(id, QString::number(id));
+
+    if(saved)
+        this->statusBar()->showMessage("Event on " + name + " saved to " + path, 10000);
+    else
+        this->statusBar()->showMessage("Could not save the event on " + name + " to " + path, 10000);
+}
+
+void MainWindow::onConnectionChanged(QString server, bool connected)
+{
+    if(connected)
+        this->statusBar()->showMessage("FA Server " + server + " connected");
+    else
+        this->statusBar()->showMessage("FA Server " + server + " disconnected, reconnecting ...");
 }
 
 void MainWindow::on_cbShow_currentIndexChanged(int index)
 {
-    x_series->setVisible(index == 0 || index == 1);
-    y_series->setVisible(index == 0 || index == 2);
+    traceView->setSeriesVisible(0, index == 0 || index == 1);
+    traceView->setSeriesVisible(1, index == 0 || index == 2);
+
+    // A hidden plane is not analysed either.
+    updateConfig();
 }
 
 void MainWindow::on_cbTime_currentIndexChanged(int index)
 {
-    if(index < 3) {
+    if(index < 3 && ui->cbSignal->currentIndex() < MODE_ORBIT) {
         ui->cbDecimation->clear();
         if(ui->cbSignal->currentIndex() == MODE_RAW)
-            ui->cbDecimation->addItems({"1:1", "Differential"});
+            ui->cbDecimation->addItems({"1:1", "10:1", "Differential"});
         else if(ui->cbSignal->currentIndex() == MODE_FFT)
             ui->cbDecimation->addItems({"1:1"});
         else if(ui->cbSignal->currentIndex() == MODE_FFT_LOGF)
@@ -543,8 +865,9 @@ void MainWindow::on_cbTime_currentIndexChanged(int index)
 
     this->samples = mSamples[index];
     this->timerPeriod = mPeriods[index];
-    this->bufferSize = this->samples * 2 * sizeof(float);
-    this->timer->setInterval(this->timerPeriod);
+    setGridWindow();
+    this->frameTimer->setInterval(this->timerPeriod);
+    updateConfig();
 }
 
 void MainWindow::on_cbSignal_currentIndexChanged(int index)
@@ -553,24 +876,32 @@ void MainWindow::on_cbSignal_currentIndexChanged(int index)
     if(index == MODE_RAW) {
         ui->cbDecimation->show();
         ui->cbDecimation->clear();
-        ui->cbDecimation->addItems({"1:1", "100:1", "Differential"});
+        ui->cbDecimation->addItems({"1:1", "10:1", "100:1", "1000:1", "Differential"});
         ui->cbWindow->hide();
         ui->cbSquared->hide();
         ui->cbFilter->hide();
         ui->cbLinear->hide();
         ui->cbReverse->hide();
+        ui->cbMultirate->hide();
+        ui->cbZoom->hide();
+        ui->cbModeSpectrum->hide();
+        ui->cbPhase->hide();
         ui->lblDec->show();
         ui->lblDec->setText("Decimation");
     }
     else if(index == MODE_FFT) {
         ui->cbDecimation->show();
         ui->cbDecimation->clear();
-        ui->cbDecimation->addItems({"1:1", "10:1"});
+        ui->cbDecimation->addItems({"1:1", QString::number(this->fftAverages) + ":1"});
         ui->cbWindow->show();
         ui->cbSquared->show();
         ui->cbFilter->hide();
         ui->cbLinear->hide();
         ui->cbReverse->hide();
+        ui->cbMultirate->hide();
+        ui->cbZoom->show();
+        ui->cbModeSpectrum->hide();
+        ui->cbPhase->hide();
         ui->lblDec->show();
         ui->lblDec->setText("Decimation");
     }
@@ -583,184 +914,474 @@ void MainWindow::on_cbSignal_currentIndexChanged(int index)
         ui->cbFilter->show();
         ui->cbLinear->hide();
         ui->cbReverse->hide();
+        ui->cbMultirate->show();
+        ui->cbZoom->hide();
+        ui->cbModeSpectrum->hide();
+        ui->cbPhase->hide();
         ui->lblDec->show();
         ui->lblDec->setText("Filter");
     }
-    else {
+    else if(index == MODE_INTEGRATED) {
         ui->cbDecimation->hide();
         ui->cbWindow->hide();
         ui->cbSquared->hide();
         ui->cbFilter->hide();
         ui->cbLinear->show();
         ui->cbReverse->show();
+        ui->cbMultirate->show();
+        ui->cbZoom->hide();
+        ui->cbModeSpectrum->hide();
+        ui->cbPhase->hide();
         ui->lblDec->hide();
     }
+    else if(index == MODE_ORBIT) {
+        ui->cbDecimation->show();
+        ui->cbDecimation->clear();
+        for(size_t k = 1; k <= this->monitor->orbitModes(); k++)
+            ui->cbDecimation->addItem("Mode " + QString::number(k));
+        ui->cbWindow->hide();
+        ui->cbSquared->hide();
+        ui->cbFilter->hide();
+        ui->cbLinear->hide();
+        ui->cbReverse->hide();
+        ui->cbMultirate->hide();
+        ui->cbZoom->hide();
+        ui->cbModeSpectrum->show();
+        ui->cbPhase->hide();
+        ui->lblDec->show();
+        ui->lblDec->setText("Mode");
+    }
+    else {
+        // The current BPM against itself (X / Y), every BPM or one other.
+        ui->cbDecimation->show();
+        ui->cbDecimation->clear();
+        ui->cbDecimation->addItem("X / Y", COHERENCE_XY);
+        ui->cbDecimation->addItem("All BPMs", COHERENCE_SCAN);
+        for(int id : this->acquisition->configuredIDs())
+            ui->cbDecimation->addItem(this->namesMap.value(id, QString::number(id)), id);
+        ui->cbWindow->hide();
+        ui->cbSquared->hide();
+        ui->cbFilter->hide();
+        ui->cbLinear->hide();
+        ui->cbReverse->hide();
+        ui->cbMultirate->hide();
+        ui->cbZoom->hide();
+        ui->cbModeSpectrum->hide();
+        ui->cbPhase->show();
+        ui->lblDec->show();
+        ui->lblDec->setText("Against");
+    }
+
+    updateConfig();
 }
 
-std::tuple<float, float> MainWindow::calculateLimits(float a, float b, float &min, float &max)
+void MainWindow::modifyAxes(bool logX, bool logY, std::tuple<float, float> rangeX, std::tuple<float, float> rangeY, const char* titleX, const char* titleY)
 {
-    max = qMax(a, max);
-    max = qMax(b, max);
-    min = qMin(a, min);
-    min = qMin(b, min);
-    return std::make_tuple(min, max);
+    this->traceView->setAxes(rangeX, rangeY, logX, logY, titleX, titleY);
 }
 
-void MainWindow::modifyAxes(std::tuple<QAbstractAxis *, QAbstractAxis *> useAxes,
-                            std::tuple<QAbstractAxis *, QAbstractAxis *> hideAxes,
-                            std::tuple<float, float> rangeX, std::tuple<float, float> rangeY, QStringList axesTitles)
+void MainWindow::readWindow(fa::buffer<float, FA_BUFFER_SIZE>& ring, const fa::history& history, float* out, size_t count)
 {
     //
-    // Other options for unpacking tuples:
-    //  1. std::tie with predefined variables
-    //  2. std::get<index>(tuple)
+    // The newest samples come from the uncompressed ring, anything older is
+    // decoded from the compressed history straight into the output window.
     //
+    size_t hot = std::min<size_t>(count, ring.size());
+    size_t cold = count - hot;
+    uint64_t end = history.end() - hot;
+    size_t missing = cold > end ? cold - end : 0;
+
+    std::fill(out, out + missing, 0);
+    history.decode(end - (cold - missing), cold - missing, out + missing, 1 / 1000.0);
+    std::copy(ring.end() - hot, ring.end(), out + cold);
+}
 
-    auto[minX, maxX] = rangeX;
-    auto[minY, maxY] = rangeY;
-    auto[useXAxis, useYAxis] = useAxes;
-    auto[hideXAxis, hideYAxis] = hideAxes;
+void MainWindow::clearHistory(QString name)
+{
+    bufferX.clear();
+    bufferY.clear();
+    decimatorX.clear();
+    decimatorY.clear();
+    zoom.clear();
+    zoomGeneration++;
+    waterfall->clear();
+    historyX.clear();
+    historyY.clear();
+    historyX.set_name(name.toStdString() + "-x");
+    historyY.set_name(name.toStdString() + "-y");
+}
+
+void MainWindow::on_cbDecimation_currentIndexChanged(int index)
+{
+    Q_UNUSED(index);
+    updateConfig();
+}
+
+void MainWindow::updateConfig()
+{
+    fa::analysis_config config;
+    QString decimation = ui->cbDecimation->currentText();
+
+    //
+    // Snapshot of the widgets, the analysis only picks a new kernel and
+    // resets its history when something actually changed.
+    //
+    config.mode       = ui->cbSignal->currentIndex();
+    config.decimation = DECIMATION_1_1;
+    config.ratio      = 1;
+    if(decimation == "Differential")
+        config.decimation = DECIMATION_DIFF;
+    else if(config.mode == MODE_RAW && decimation.endsWith(":1"))
+        config.ratio = decimation.section(':', 0, 0).toInt();
+    else if(config.mode == MODE_FFT && ui->cbDecimation->currentIndex() == 1)
+        config.decimation = FFT_10_1;
+    else if(config.mode == MODE_ORBIT)
+        config.decimation = qMax(0, ui->cbDecimation->currentIndex());
+    else if(config.mode == MODE_COHERENCE)
+        config.decimation = ui->cbDecimation->currentData().toInt();
+
+    config.window    = ui->cbWindow->isChecked();
+    config.squared   = ui->cbSquared->isChecked();
+    config.filter    = ui->cbFilter->isChecked();
+    config.linear    = ui->cbLinear->isChecked();
+    config.reverse   = ui->cbReverse->isChecked();
+    config.multirate = ui->cbMultirate->isChecked() && (config.mode == MODE_FFT_LOGF || config.mode == MODE_INTEGRATED);
+    config.samples   = this->samples;
+    config.averages  = this->fftAverages;
+    config.overlap   = this->fftOverlap;
+    config.logFilter = config.mode == MODE_FFT_LOGF ? 1.0 / std::pow(10, qMax(0, ui->cbDecimation->currentIndex())) : 1;
+    config.frequency = this->samplingFrequency;
+    config.orbitSpectrum = ui->cbModeSpectrum->isChecked();
+    config.phase     = ui->cbPhase->isChecked();
+    config.hidden    = ui->cbShow->currentIndex() == 1 ? PLANE_Y : ui->cbShow->currentIndex() == 2 ? PLANE_X : 0;
+
+    // The orbit and coherence analyses only run while they are shown.
+    this->monitor->setOrbit(config.mode == MODE_ORBIT);
+    this->monitor->setCoherence(config.mode == MODE_COHERENCE);
+    streamRing();
 
-    for(auto series : this->chart->series()) {
-        if(series->attachedAxes().contains(hideYAxis))
-            series->detachAxis(hideYAxis);
-        if(series->attachedAxes().contains(hideXAxis))
-            series->detachAxis(hideXAxis);
-        if(!series->attachedAxes().contains(useYAxis))
-            series->attachAxis(useYAxis);
-        if(!series->attachedAxes().contains(useXAxis))
-            series->attachAxis(useXAxis);
+    //
+    // With band zoom on, a drag over the spectrum selects the band, which
+    // stays until the box is unchecked.
+    //
+    bool banded = config.mode == MODE_FFT && ui->cbZoom->isChecked();
+    traceView->setBandSelection(banded);
+    config.bandLow  = banded ? this->bandLow : 0;
+    config.bandHigh = banded ? this->bandHigh : 0;
+    config.zoom     = fa::zoom::ratio(config.bandLow, config.bandHigh, config.frequency);
+
+    if(config != this->analysis.config()) {
+        const fa::analysis_config& previous = this->analysis.config();
+        if(config.zoom != previous.zoom || config.bandLow != previous.bandLow || config.bandHigh != previous.bandHigh)
+            tuneZoom(config);
+
+        this->analysis.configure(config);
+        this->steadyTicks = 0;
+
+        // A frozen window is redrawn in the new mode from its snapshot.
+        if(this->firstTrace && !traceView->m_isRunning) {
+            this->frozenRange = {0, this->samples / 10.0};
+            renderFrozen();
+        }
     }
+}
+
+void MainWindow::onBandSelected(qreal low, qreal high)
+{
+    // The full spectrum is plotted against its window index, a band in Hz.
+    qreal scale = this->analysis.config().zoom > 0 ? 1 : this->samplingFrequency / this->samples;
+
+    this->bandLow = qMax<qreal>(0, low * scale);
+    this->bandHigh = qMin<qreal>(this->samplingFrequency / 2, high * scale);
+    if(this->bandHigh <= this->bandLow)
+        return;
 
-    useXAxis->setRange(minX, maxX);
-    useXAxis->setTitleText(axesTitles[0]);
-    useYAxis->setRange(minY, maxY);
-    useYAxis->setTitleText(axesTitles[1]);
-    ((QValueAxis*)useYAxis)->applyNiceNumbers();
+    updateConfig();
+
+    // The band is followed live, unlike a chart zoom.
+    if(!traceView->m_isRunning) {
+        traceView->m_isRunning = true;
+        this->frozen.reset();
+        this->frozenSource.reset();
+        this->timer->start();
+    }
+}
 
-    hideYAxis->hide();
-    hideXAxis->hide();
-    useYAxis->show();
-    useXAxis->show();
+void MainWindow::tuneZoom(const fa::analysis_config& config)
+{
+    // The live mixer starts over at once, the history is mixed behind it.
+    this->zoomTuning = config;
+    this->zoomGeneration++;
+    this->zoom.tune((config.bandLow + config.bandHigh) / 2, config.zoom, config.frequency);
+    if(config.zoom > 0)
+        seedZoom();
 }
 
-void MainWindow::computeFFT(std::vector<float> &data_x, std::vector<float> &data_y, std::vector<float> &fft_x, std::vector<float> &fft_y)
+void MainWindow::seedZoom()
 {
-    size_t samples = qMin<size_t>(data_x.size(), data_y.size());
+    // A run in progress is redone from onZoomSeeded().
+    if(this->zoomWatcher->isRunning())
+        return;
 
-    if(ui->cbWindow->isChecked()) {
-        float delta = (M_PI - -M_PI ) / (samples - 1);
-        for(size_t i = 0; i < samples; i++) {
-            data_x[i] *= 1 + cos(-M_PI + delta * i);
-            data_y[i] *= 1 + cos(-M_PI + delta * i);
+    //
+    // Rather than waiting up to FA_ZOOM_LENGTH decimated samples for the
+    // ring to fill, the history that covers it is run through a mixer of
+    // its own on a worker: up to 1000 x FA_ZOOM_LENGTH samples per plane.
+    //
+    const fa::analysis_config& config = this->zoomTuning;
+    uint64_t end = this->historyX.end();
+    uint64_t start = end - std::min<uint64_t>(uint64_t(FA_ZOOM_LENGTH) * config.zoom, end - this->historyX.begin());
+    fa::history_view x = this->historyX.view(start);
+    fa::history_view y = this->historyY.view(start);
+    double centre = (config.bandLow + config.bandHigh) / 2;
+    int ratio = config.zoom;
+    double rate = config.frequency;
+
+    this->zoomSeedGeneration = this->zoomGeneration;
+    this->zoomSeedEnd = end;
+    this->zoomWatcher->setFuture(QtConcurrent::run([x, y, start, end, centre, ratio, rate]() {
+        auto seed = std::make_shared<fa::zoom>();
+        std::vector<float> scratchX(std::min<uint64_t>(FA_BUFFER_SIZE, end - start));
+        std::vector<float> scratchY(scratchX.size());
+        size_t count;
+
+        seed->tune(centre, ratio, rate);
+        for(uint64_t i = start; i < end; i += count) {
+            count = std::min<uint64_t>(scratchX.size(), end - i);
+            x.decode(i, count, scratchX.data(), 1);
+            y.decode(i, count, scratchY.data(), 1);
+            for(size_t k = 0; k < count; k++)
+                seed->push_back(std::lrint(scratchX[k]), std::lrint(scratchY[k]));
         }
+        return seed;
+    }));
+}
+
+void MainWindow::onZoomSeeded()
+{
+    // Retuned or switched BPM while it ran: seed again for the new band.
+    if(this->zoomSeedGeneration != this->zoomGeneration) {
+        if(this->zoom.tuned())
+            seedZoom();
+        return;
     }
-    cv::dft(data_x, data_x);
-    cv::dft(data_y, data_y);
 
-    fft_x.push_back(abs(data_x[0]) * sqrt(2 / (this->samplingFrequency * samples)));
-    fft_y.push_back(abs(data_y[0]) * sqrt(2 / (this->samplingFrequency * samples)));
-    for(int i = 1; i < qMin<int>(data_x.size(), data_y.size()) - 2; i += 2) {
-        fft_x.push_back( std::abs( std::complex<float>(data_x[i], data_x[i+1]) ) * sqrt(2 / (this->samplingFrequency * samples)));
-        fft_y.push_back( std::abs( std::complex<float>(data_y[i], data_y[i+1]) ) * sqrt(2 / (this->samplingFrequency * samples)));
+    //
+    // The seed ends where the worker's view of the history did, the few
+    // samples taken in since are mixed here before it replaces the live
+    // mixer.
+    //
+    std::shared_ptr<fa::zoom> seed = this->zoomWatcher->result();
+    uint64_t end = this->historyX.end();
+    std::vector<float> scratchX(std::min<uint64_t>(FA_BUFFER_SIZE, end - this->zoomSeedEnd));
+    std::vector<float> scratchY(scratchX.size());
+    size_t count;
+
+    for(uint64_t i = this->zoomSeedEnd; i < end; i += count) {
+        count = std::min<uint64_t>(scratchX.size(), end - i);
+        this->historyX.decode(i, count, scratchX.data(), 1);
+        this->historyY.decode(i, count, scratchY.data(), 1);
+        for(size_t k = 0; k < count; k++)
+            seed->push_back(std::lrint(scratchX[k]), std::lrint(scratchY[k]));
     }
+    this->zoom = std::move(*seed);
 }
 
-void MainWindow::initSocket()
+void MainWindow::on_cbLines_toggled(bool checked)
 {
-    int args;
-    int status;
-    struct timeval tv;
-    fd_set read_fds;
-    fd_set write_fds;
-    QString ip = resolveHostname(this->ipAddress);
-    if(ip.isEmpty())
-    {
-        QMessageBox::warning(this, "Error", "Could not resolve hostname/IP " + this->ipAddress, QMessageBox::Ok);
-        ::exit(1);
-    }
+    if(this->linesDock)
+        this->linesDock->setVisible(checked);
+}
 
-    this->sock = socket(AF_INET, SOCK_STREAM, 0);
-    srv.sin_port = htons(this->port);
-    srv.sin_family = AF_INET;
-    srv.sin_addr.s_addr = inet_addr(ip.toStdString().c_str());
-
-    args  = fcntl(this->sock, F_GETFL, NULL);
-    args |= O_NONBLOCK;
-    status = ::fcntl(this->sock, F_SETFL, args);
-    status = ::connect(this->sock, (struct sockaddr*) &srv, sizeof(struct sockaddr));
-    if(status < 0) {
-        if(errno == EINPROGRESS)
-        {
-            tv.tv_sec = 1;
-            tv.tv_usec = 0;
-
-            FD_ZERO(&read_fds);
-            FD_ZERO(&write_fds);
-            FD_SET(this->sock, &read_fds);
-            FD_SET(this->sock, &write_fds);
-            status = ::select(this->sock + 1, &read_fds, &write_fds, NULL, &tv);
-            if(status <= 0 && errno != EINTR)
-            {
-                QMessageBox::warning(this, "Error", "Server connection timeout.");
-                ::exit(4);
-            }
-            else {
-                ::close(this->sock);
-                this->sock = socket(AF_INET, SOCK_STREAM, 0);
-                srv.sin_port = htons(this->port);
-                srv.sin_family = AF_INET;
-                srv.sin_addr.s_addr = inet_addr(ip.toStdString().c_str());
-                args = fcntl(this->sock, F_GETFL, NULL);
-                args &= ~(O_NONBLOCK);
-                status = fcntl(this->sock, F_SETFL, args);
-                status = ::connect(this->sock, (struct sockaddr*) &srv, sizeof(struct sockaddr));
+void MainWindow::on_cbWaterfall_toggled(bool checked)
+{
+    this->waterfallDock->setVisible(checked);
+}
+
+void MainWindow::updateLines()
+{
+    const std::vector<float>& lines = this->monitor->frequencies();
+    QList<int> ids = this->monitor->ids();
+    QStringList alarms;
+
+    //
+    // Alarms are raised whether or not the table is shown, a cell turns
+    // red while either axis is above the threshold.
+    //
+    this->linesTable->setRowCount(ids.size());
+    for(int row = 0; row < ids.size(); row++) {
+        QString name = this->namesMap.value(ids[row], QString::number(ids[row]));
+        QTableWidgetItem* header = this->linesTable->verticalHeaderItem(row);
+        if(!header || header->text() != name)
+            this->linesTable->setVerticalHeaderItem(row, new QTableWidgetItem(name));
+
+        for(size_t line = 0; line < lines.size(); line++) {
+            float x = this->monitor->amplitude(ids[row], line, 0);
+            float y = this->monitor->amplitude(ids[row], line, 1);
+            bool alarm = qMax(x, y) > this->monitor->threshold();
+            QTableWidgetItem* item = this->linesTable->item(row, line);
+            if(!item) {
+                item = new QTableWidgetItem;
+                item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+                this->linesTable->setItem(row, line, item);
             }
+
+            item->setText(QString::asprintf("%.3f / %.3f", x, y));
+            item->setBackground(alarm ? QBrush(QColor(255, 160, 160)) : QBrush());
+            if(alarm)
+                alarms << name + " @ " + QString::number(lines[line]) + " Hz";
         }
     }
+
+    if(alarms.isEmpty())
+        this->linesAlarm->clear();
+    else if(alarms.size() <= 3)
+        this->linesAlarm->setText("Line alarm: " + alarms.join(", "));
+    else
+        this->linesAlarm->setText(QString::asprintf("Line alarm: %d lines above threshold", alarms.size()));
+}
+
+void MainWindow::on_cbStats_toggled(bool checked)
+{
+    this->statsDock->setVisible(checked);
+    this->monitor->setStatistics(checked);
+    streamRing();
 }
 
-void MainWindow::readFrequency()
+void MainWindow::on_cbHeatmap_toggled(bool checked)
 {
-    char buffer[12];
+    this->heatmapDock->setVisible(checked);
+    this->monitor->setHeatmap(checked);
+    streamRing();
+}
 
-    initSocket();
-    ::write(sock, FA_CMD_CF, strlen(FA_CMD_CF));
-    ::read(sock, buffer, sizeof(buffer));
-    ::close(sock);
+void MainWindow::updateHeatmap()
+{
+    QStringList names;
 
-    buffer[11] = '\0';
-    this->samplingFrequency = atof(buffer);
+    // Rows follow the monitor's BPMs, in id and so in cell order.
+    for(int id : this->monitor->ids())
+        names << this->namesMap.value(id, QString::number(id));
+    this->heatmap->setHeatmap(&this->monitor->heatmap(), this->heatmapShow->currentIndex(), names, this->bpms);
 }
 
-void MainWindow::on_cbDecimation_currentIndexChanged(int index)
+void MainWindow::on_cbGrid_toggled(bool checked)
+{
+    this->traceView->setVisible(!checked);
+    this->gridPanel->setVisible(checked);
+    updateGrid();
+    streamRing();
+}
+
+void MainWindow::updateGrid()
 {
-    if(ui->cbSignal->currentIndex() == MODE_FFT_LOGF) {
-        this->resetLogFilter = true;
-        this->logFilter = 1.0 / std::pow(10, index);
+    QList<int> ids;
+    QStringList names;
+
+    if(this->gridSet->currentIndex() > 0) {
+        for(auto it = this->cellsMap.begin(); it != this->cellsMap.end(); it++) {
+            if(it.value().first == this->gridSet->currentIndex())
+                ids << it.key();
+        }
+    }
+    else {
+        for(QString part : this->gridPicked->text().split(',', QString::SkipEmptyParts)) {
+            int first = part.section('-', 0, 0).trimmed().toInt();
+            int last = part.contains('-') ? part.section('-', 1, 1).trimmed().toInt() : first;
+            for(int id = first; id > 0 && id <= last && ids.size() < FA_GRID_TILES; id++)
+                ids << id;
+        }
     }
+
+    for(int id : ids)
+        names << this->namesMap.value(id, QString::number(id));
+    this->grid->setBPMs(ids, names);
+    this->grid->setMode(this->gridShow->currentIndex());
+    setGridWindow();
 }
 
-QString MainWindow::resolveHostname(QString hostname)
+void MainWindow::setGridWindow()
 {
-    int status;
-    char ip[16];
-    struct addrinfo hints;
-    struct addrinfo *info;
-    struct sockaddr_in* host;
+    // The tiles read the per-BPM streams, which do not reach back as far
+    // as the longer windows.
+    this->grid->setSamples(this->samples);
+    QString span = QString::number(this->grid->window() / this->samplingFrequency, 'g', 3) + " s";
+    if(this->grid->window() < size_t(this->samples))
+        this->gridWindow->setText("Last " + span + ", the most a stream holds");
+    else
+        this->gridWindow->setText("Last " + span);
+}
 
-    memset(&hints, 0, sizeof(struct addrinfo));
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
+void MainWindow::onGridSelected(int id)
+{
+    // Back to the single plot, on the double-clicked BPM.
+    ui->cbGrid->setChecked(false);
+    if(this->cellsMap.contains(id)) {
+        ui->cbCells->setCurrentIndex(this->cellsMap[id].first);
+        ui->cbID->setCurrentText(this->namesMap[id]);
+    }
+    else {
+        ui->cbCells->setCurrentIndex(0);
+        ui->txtBPM->setText(QString::number(id));
+        on_txtBPM_returnPressed();
+    }
+}
 
-    status = getaddrinfo(hostname.toStdString().c_str(), "http", &hints, &info);
-    if(status != 0)
-        return "";
+void MainWindow::streamRing()
+{
+    // The grid reads every BPM it shows from the buses, like the monitors.
+    bool ring = this->monitor->active() || ui->cbGrid->isChecked();
 
-    host = (struct sockaddr_in*) info->ai_addr;
-    strncpy(ip, inet_ntoa(host->sin_addr), sizeof(ip));
-    freeaddrinfo(info);
-    return QString(ip);
+    // Without a daemon, every BPM is streamed only while a ring monitor needs it.
+    if(ring != this->streaming && !this->bus.attached())
+        this->acquisition->subscribe(ring ? this->acquisition->configuredIDs() : QList<int>{this->currentID});
+    this->streaming = ring;
+}
+
+void MainWindow::updateStats()
+{
+    int statistic = this->statsShow->currentIndex() / 2;
+    int axis = this->statsShow->currentIndex() % 2;
+    std::vector<float> values;
+    float median;
+
+    if(!ui->cbStats->isChecked())
+        return;
+
+    for(auto it = this->cellsMap.begin(); it != this->cellsMap.end(); it++)
+        values.push_back(std::abs(this->monitor->statistic(it.key(), statistic, axis)));
+    if(values.empty())
+        return;
+
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    median = values[values.size() / 2];
+
+    //
+    // Green up to the ring median, then towards red at four times it, so
+    // an outlier stands out whatever the statistic's scale.
+    //
+    this->statsTable->setRowCount(this->cells);
+    for(auto it = this->cellsMap.begin(); it != this->cellsMap.end(); it++) {
+        int row = it.value().first - 1;
+        int column = it.value().second;
+        float value = this->monitor->statistic(it.key(), statistic, axis);
+        float ratio = median > 0 ? std::abs(value) / median : 1;
+        float level = qBound(0.0f, std::log2(qMax(ratio, 1.0f)) / 2, 1.0f);
+
+        if(column >= this->statsTable->columnCount())
+            this->statsTable->setColumnCount(column + 1);
+
+        QTableWidgetItem* item = this->statsTable->item(row, column);
+        if(!item) {
+            item = new QTableWidgetItem;
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            this->statsTable->setItem(row, column, item);
+        }
+
+        item->setText(QString::asprintf("%.3f", value));
+        item->setToolTip(this->namesMap.value(it.key()));
+        item->setBackground(QColor::fromHsvF((1 - level) / 3, 0.5, 1));
+    }
 }
 
 void MainWindow::on_txtBPM_returnPressed()
@@ -770,14 +1391,12 @@ void MainWindow::on_txtBPM_returnPressed()
     id = ui->txtBPM->text().toInt();
     if(id >= this->firstID && id <= (this->firstID + this->ids - 1))
     {
-        for(auto item : this->idsMap.toStdMap()) {
-            if(item.second == id)
-                this->chart->setTitle(item.first);
-        }
+        if(this->namesMap.contains(id))
+            this->traceView->setTitle(this->namesMap[id]);
 
-        this->message = "S" + QString::number(ui->txtBPM->text().toInt()) + "\n";
+        this->currentID = id;
         this->timer->stop();
-        ::close(this->sock);
+        clearHistory(this->traceView->title());
         reconnectToServer();
     }
 }
@@ -796,25 +1415,45 @@ void MainWindow::displayTooltip()
 {
     QString msg = "Frequency: %.0f Hz\nX: %f %s | Y: %f %s";
     QString unit;
-    int scale = 1;
-    if (ui->cbSignal->currentIndex() == MODE_FFT)
+    float scale = 1;
+    int point;
+    const fa::analysis_config& config = this->analysis.config();
+    if (config.mode == MODE_FFT)
         unit = "um/√Hz";
-    else if (ui->cbSignal->currentIndex() == MODE_FFT_LOGF)
-        unit = ui->cbSquared->isChecked() ? "um^2/Hz" : "um/√Hz";
+    else if (config.mode == MODE_FFT_LOGF)
+        unit = config.squared ? "um^2/Hz" : "um/√Hz";
+    else if (config.mode == MODE_ORBIT) {
+        unit = config.orbitSpectrum ? "um/√Hz" : "um";
+        if (!config.orbitSpectrum)
+            msg = "BPM: %.0f\nX: %f %s | Y: %f %s";
+    }
+    else if (config.mode == MODE_COHERENCE) {
+        unit = config.phase && config.decimation != COHERENCE_SCAN ? "deg" : "";
+        if (config.decimation == COHERENCE_SCAN)
+            msg = "BPM: %.0f\nX: %f %s | Y: %f %s";
+    }
     else {
         unit = "um";
-        if (ui->cbSignal->currentIndex() == MODE_RAW) {
-            scale = 10;
+        if (config.mode == MODE_RAW) {
+            scale = 10.0 / config.ratio;
             msg = "Time: %.1f ms\nX: %.3f %s | Y: %.3f %s";
         }
     }
 
-    if(this->isActiveWindow() && chart->plotArea().contains(chartView->m_pos)) {
+    point = traceView->m_mouseIndex * scale;
+    if (config.mode == MODE_RAW && this->frozen && !traceView->m_isRunning)
+        point = std::lower_bound(this->trace.index.begin(), this->trace.index.end(), float(traceView->m_mouseIndex)) - this->trace.index.begin();
+    if (((config.mode == MODE_FFT && config.zoom > 0) || (config.mode == MODE_ORBIT && config.orbitSpectrum) ||
+         (config.mode == MODE_COHERENCE && config.decimation != COHERENCE_SCAN)) && this->trace.index.size() > 1) {
+        msg = "Frequency: %.3f Hz\nX: %f %s | Y: %f %s";
+        point = std::lround((traceView->m_mouseIndex - this->trace.index[0]) / (this->trace.index[1] - this->trace.index[0]));
+    }
+    if(this->isActiveWindow() && traceView->plotArea().contains(traceView->m_pos) && point >= 0 && point < int(this->trace.index.size())) {
         QString text = QString::asprintf(msg.toStdString().c_str(),
-                                        chartView->m_mouseIndex,
-                                        x_series->at(chartView->m_mouseIndex * scale).y(), unit.toStdString().c_str(),
-                                        y_series->at(chartView->m_mouseIndex * scale).y(), unit.toStdString().c_str());
-        QToolTip::showText(chartView->m_globalPos, text);
+                                        traceView->m_mouseIndex,
+                                        this->trace.x[point], unit.toStdString().c_str(),
+                                        this->trace.y[point], unit.toStdString().c_str());
+        QToolTip::showText(traceView->m_globalPos, text);
     }
     else
         QToolTip::hideText();
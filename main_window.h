@@ -4,17 +4,20 @@
 #include <QMainWindow>
 #include <QTcpSocket>
 #include <QTimer>
-#include <QtCharts/QChartView>
-#include <QtCharts/QLineSeries>
-#include <QtCharts/QSplineSeries>
-#include <QtCharts/QLogValueAxis>
-#include <QtCharts/QValueAxis>
 #include <QtEndian>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QMessageBox>
 #include <QStatusBar>
 #include <QToolTip>
+#include <QElapsedTimer>
+#include <QComboBox>
+#include <QDockWidget>
+#include <QTableWidget>
+#include <QLabel>
+#include <QLineEdit>
+#include <QWindow>
+#include <QFutureWatcher>
 
 #include <cstdio>
 #include <cmath>
@@ -33,30 +36,29 @@ using std::endl;
 
 #include <opencv2/core/core.hpp>
 
-#include <chart.h>
-#include <chartview.h>
+#include <gridview.h>
+#include <heatmapview.h>
+#include <traceview.h>
+#include <waterfallview.h>
 #include <fa_tools.h>
+#include <fa_history.h>
+#include <fa_bus.h>
+#include <fa_acquisition.h>
+#include <fa_analysis.h>
+#include <fa_decimator.h>
+#include <fa_monitor.h>
+#include <fa_snapshot.h>
 
-using namespace QT_CHARTS_NAMESPACE;
-
-#define MAX_BUFFER_SIZE 80000
 #define MIN_BUFFER_SIZE 8000
-#define FA_BUFFER_SIZE  500000
-
-#define MODE_RAW            0
-#define MODE_FFT            1
-#define MODE_FFT_LOGF       2
-#define MODE_INTEGRATED     3
-
-#define DECIMATION_1_1      0
-#define DECIMATION_100_1    1
-#define DECIMATION_DIFF     2
-
-#define FFT_1_1     0
-#define FFT_10_1    1
-
-#define FA_CMD_CF       "CF\n"
-#define FA_CMD_CL       "CL\n"
+#define SAMPLING_RATE   10000
+#define FA_BUFFER_SIZE  100000
+#define FA_HISTORY_TIME 600
+#define FA_SPILL_BUDGET 10240
+#define FA_SPILL_RETENTION  24
+#define FA_FFT_AVERAGES     10
+#define FA_INGEST_PERIOD    50
+#define FA_FRAME_BUDGET     0.5
+#define FA_FRAME_SLOWDOWN   8
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -72,22 +74,45 @@ public:
 
     void reconnectToServer();
 
-    void initSocket();
+    void render();
+
+    void present(const fa::analysis_config& config);
+
+    bool analyseWindow();
+
+    bool analyseSnapshot(const fa::snapshot& data, fa::analysis_config config, std::tuple<float, float> range);
+
+    void renderFrozen();
+
+    void streamRing();
 
-    QString resolveHostname(QString hostname);
+    void buildIndex();
 
-    void readFrequency();
+    void ingest(const char* data, size_t bytes);
 
-    void computeFFT(std::vector<float>& data_x, std::vector<float>& data_y, std::vector<float>& fft_x, std::vector<float>& fft_y);
+    void clearHistory(QString name);
 
-    std::tuple<float, float> calculateLimits(float a, float b, float& min, float& max);
+    void readWindow(fa::buffer<float, FA_BUFFER_SIZE>& ring, const fa::history& history, float* out, size_t count);
 
-    void modifyAxes(std::tuple<QAbstractAxis*, QAbstractAxis*> useAxes, std::tuple<QAbstractAxis*,
-                    QAbstractAxis*> hideAxes, std::tuple<float, float> rangeX, std::tuple<float, float> rangeY, QStringList axesTitles);
+    void tuneZoom(const fa::analysis_config& config);
+
+    void seedZoom();
+
+    void pace(double cost);
+
+    void modifyAxes(bool logX, bool logY, std::tuple<float, float> rangeX, std::tuple<float, float> rangeY, const char* titleX, const char* titleY);
 
 private slots:
     void pollServer();
 
+    void onFrame();
+
+    void onConnectionChanged(QString server, bool connected);
+
+    void onBPMListChanged(QStringList names);
+
+    void onCaptured(int id, QString path, bool saved);
+
     void on_cbCells_currentIndexChanged(int index);
 
     void on_cbID_currentIndexChanged(const QString &arg1);
@@ -100,6 +125,40 @@ private slots:
 
     void on_cbDecimation_currentIndexChanged(int index);
 
+    void updateConfig();
+
+    void onBandSelected(qreal low, qreal high);
+
+    void freeze();
+
+    void onRangeChanged(qreal min, qreal max);
+
+    void onFrozenRendered();
+
+    void onZoomSeeded();
+
+    void on_cbLines_toggled(bool checked);
+
+    void updateLines();
+
+    void on_cbStats_toggled(bool checked);
+
+    void updateStats();
+
+    void on_cbWaterfall_toggled(bool checked);
+
+    void on_cbHeatmap_toggled(bool checked);
+
+    void updateHeatmap();
+
+    void on_cbGrid_toggled(bool checked);
+
+    void updateGrid();
+
+    void setGridWindow();
+
+    void onGridSelected(int id);
+
     void on_txtBPM_returnPressed();
 
     bool eventFilter(QObject *watched, QEvent *event);
@@ -110,43 +169,88 @@ private:
     Ui::MainWindow *ui;
 
     QTimer* timer;
-
-    QChart x;
-    Chart* chart;
-    ChartView* chartView;
+    QTimer* frameTimer;
+    QElapsedTimer rateClock;
+    QLabel* rateLabel;
+    double analysisCost;
+    int analyses;
+    int displayed;
+    QElapsedTimer startup;
+    QString startupReport;
+    bool firstTrace;
+
+    TraceView* traceView;
 
     fa::buffer<float, FA_BUFFER_SIZE> bufferX;
     fa::buffer<float, FA_BUFFER_SIZE> bufferY;
+    fa::history historyX;
+    fa::history historyY;
+    fa::decimator decimatorX;
+    fa::decimator decimatorY;
+    fa::zoom zoom;
+    fa::analysis_config zoomTuning;
+    QFutureWatcher<std::shared_ptr<fa::zoom>>* zoomWatcher;
+    unsigned zoomGeneration;
+    unsigned zoomSeedGeneration;
+    uint64_t zoomSeedEnd;
+    fa::bus bus;
+    uint64_t busSequence;
+    FaAcquisition* acquisition;
+    FaMonitor* monitor;
+    QDockWidget* linesDock;
+    QTableWidget* linesTable;
+    QLabel* linesAlarm;
+    QDockWidget* statsDock;
+    QTableWidget* statsTable;
+    QComboBox* statsShow;
+    QDockWidget* waterfallDock;
+    WaterfallView* waterfall;
+    QDockWidget* heatmapDock;
+    HeatmapView* heatmap;
+    QComboBox* heatmapShow;
+    QWidget* gridPanel;
+    GridView* grid;
+    QComboBox* gridSet;
+    QLineEdit* gridPicked;
+    QLabel* gridWindow;
+    QComboBox* gridShow;
+    fa::analysis analysis;
+    fa::trace trace;
+    std::vector<float> windowX;
+    std::vector<float> windowY;
+    int steadyTicks;
+    size_t libraryBudget;
+
+    std::shared_ptr<fa::snapshot> frozen;
+    std::shared_ptr<const fa::snapshot_source> frozenSource;
+    std::tuple<float, float> frozenRange;
+    fa::analysis frozenAnalysis;
+    fa::trace frozenTrace;
+    std::vector<float> frozenX;
+    std::vector<float> frozenY;
+    QFutureWatcher<bool>* frozenWatcher;
+    bool frozenPending;
 
-    QLineSeries* x_series;
-    QLineSeries* y_series;
-    QValueAxis* xAxis;
-    QValueAxis* yAxis;
-    QLogValueAxis* yLogAxis;
-    QLogValueAxis* xLogAxis;
     QMap<QString, int> idsMap;
+    QMap<int, QString> namesMap;
+    QMap<int, QPair<int, int>> cellsMap;
     QString format;
-    QString message;
-    QString ipAddress;
     QStringList bpmIDs;
 
-    std::vector<float> fft_logf_x;
-    std::vector<float> fft_logf_y;
-
-    struct sockaddr_in srv;
-
     float samplingFrequency;
-    int sock;
+    int historyTime;
+    int currentID;
     int cells;
     int bpms;
     int firstID;
     int ids;
-    int port;
     int samples;
-    int bufferSize;
     int timerPeriod;
-    bool resetLogFilter;
-    float logFilter;
+    int fftAverages;
+    float fftOverlap;
+    float bandLow;
+    float bandHigh;
+    bool streaming;
     bool m_isTouching;
     int mSamples[9] = {1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000};
     int mPeriods[9] = {100, 250, 500, 1000, 1000, 1000, 1000, 1000, 1000};
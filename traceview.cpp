@@ -0,0 +1,496 @@
+#include "traceview.h"
+
+#include <QElapsedTimer>
+#include <QGestureEvent>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QtConcurrent>
+
+#include <cmath>
+
+#include <fa_tools.h>
+
+#define TRACE_MARGIN_LEFT   72
+#define TRACE_MARGIN_RIGHT  24
+#define TRACE_MARGIN_TOP    60
+#define TRACE_MARGIN_BOTTOM 48
+
+static const QColor seriesColours[2] = {QColor(0x20, 0x9f, 0xdf), Qt::red};
+static const char* seriesNames[2] = {"Horizontal", "Vertical"};
+
+TraceView::TraceView(QWidget *parent) :
+    QWidget(parent),
+    dirty(false),
+    drawn(0),
+    cost(0),
+    workingCost(0),
+    m_selectBand(false),
+    m_band(nullptr)
+{
+    m_isRunning = true;
+    m_isMouseOver = false;
+    m_mouseIndex = 0;
+
+    this->pending.ratio = 1;
+    this->pending.x = {0, 1, false, 1};
+    this->pending.y = {0, 1, false, 1};
+    this->pending.ticks = FA_PLOT_TICKS;
+    this->pending.ticksY = FA_PLOT_TICKS;
+    this->pending.visible[0] = true;
+    this->pending.visible[1] = true;
+    this->pending.titles[0][0] = '\0';
+    this->pending.titles[1][0] = '\0';
+    this->pending.data.min = 0;
+    this->pending.data.max = 1;
+    this->pending.data.bins = 0;
+
+    this->watcher = new QFutureWatcher<QImage>(this);
+    QObject::connect(this->watcher, &QFutureWatcher<QImage>::finished, this, &TraceView::onFrameReady);
+
+    setAttribute(Qt::WA_OpaquePaintEvent, true);
+    setAttribute(Qt::WA_Hover, true);
+    setAttribute(Qt::WA_AcceptTouchEvents, true);
+    setFocusPolicy(Qt::StrongFocus);
+    setMouseTracking(true);
+    setMinimumSize(300, 200);
+    grabGesture(Qt::PanGesture);
+    grabGesture(Qt::PinchGesture);
+}
+
+TraceView::~TraceView()
+{
+    this->watcher->waitForFinished();
+}
+
+void TraceView::setTitle(const QString& title)
+{
+    this->pending.title = title;
+    requestFrame();
+}
+
+QString TraceView::title() const
+{
+    return this->pending.title;
+}
+
+void TraceView::setSeriesVisible(int series, bool visible)
+{
+    this->pending.visible[series] = visible;
+    requestFrame();
+}
+
+void TraceView::setTickCount(int ticks)
+{
+    this->pending.ticks = ticks;
+}
+
+void TraceView::setAxes(std::tuple<float, float> rangeX, std::tuple<float, float> rangeY, bool logX, bool logY,
+                        const char* titleX, const char* titleY)
+{
+    auto[minX, maxX] = rangeX;
+    auto[minY, maxY] = rangeY;
+
+    // A flat trace still gets a range to sit in.
+    if(!(maxY > minY)) {
+        minY = logY ? minY / 10 : minY - 1;
+        maxY = logY ? maxY * 10 : maxY + 1;
+    }
+    if(logY && minY <= 0)
+        minY = maxY * 1e-6f;
+    if(!(maxX > minX))
+        maxX = minX + 1;
+
+    this->pending.ticksY = logY ? 0 : fa::nice_range(minY, maxY, FA_PLOT_TICKS - 1);
+    this->pending.x = {minX, maxX, logX, 1};
+    this->pending.y = {minY, maxY, logY, 1};
+    qstrncpy(this->pending.titles[0], titleX, TRACE_TITLE_LENGTH);
+    qstrncpy(this->pending.titles[1], titleY, TRACE_TITLE_LENGTH);
+}
+
+void TraceView::setTrace(const fa::trace& trace)
+{
+    //
+    // Copied into vectors that keep their capacity, so a steady stream of
+    // equally sized traces does not allocate.
+    //
+    this->pending.data.index.assign(trace.index.begin(), trace.index.end());
+    this->pending.data.x.assign(trace.x.begin(), trace.x.end());
+    this->pending.data.y.assign(trace.y.begin(), trace.y.end());
+    this->pending.data.min = trace.min;
+    this->pending.data.max = trace.max;
+    this->pending.data.bins = trace.bins;
+    requestFrame();
+}
+
+void TraceView::clear()
+{
+    this->pending.data.index.clear();
+    this->pending.data.x.clear();
+    this->pending.data.y.clear();
+    requestFrame();
+}
+
+void TraceView::setBandSelection(bool enabled)
+{
+    m_selectBand = enabled;
+    if (!enabled && m_band)
+        m_band->hide();
+}
+
+QRect TraceView::area(QSize size)
+{
+    return QRect(TRACE_MARGIN_LEFT, TRACE_MARGIN_TOP,
+                 qMax(1, size.width() - TRACE_MARGIN_LEFT - TRACE_MARGIN_RIGHT),
+                 qMax(1, size.height() - TRACE_MARGIN_TOP - TRACE_MARGIN_BOTTOM));
+}
+
+QRect TraceView::plotArea() const
+{
+    return area(size());
+}
+
+fa::scale TraceView::scaleX() const
+{
+    fa::scale x = this->pending.x;
+    x.pixels = plotArea().width();
+    return x;
+}
+
+fa::scale TraceView::scaleY() const
+{
+    fa::scale y = this->pending.y;
+    y.pixels = plotArea().height();
+    return y;
+}
+
+void TraceView::requestFrame()
+{
+    if(this->watcher->isRunning()) {
+        this->dirty = true;
+        return;
+    }
+
+    this->dirty = false;
+    this->pending.size = size();
+    this->pending.ratio = devicePixelRatioF();
+    this->pending.x.pixels = plotArea().width();
+    this->pending.y.pixels = plotArea().height();
+    this->working = this->pending;
+
+    // The task object is QtConcurrent's own.
+    FA_UNCOUNTED;
+    this->watcher->setFuture(QtConcurrent::run([this]() {
+        QElapsedTimer clock;
+        clock.start();
+        QImage out = rasterise(this->working, this->reduced);
+        this->workingCost = clock.nsecsElapsed() / 1e6;
+        return out;
+    }));
+}
+
+void TraceView::onFrameReady()
+{
+    this->image = this->watcher->result();
+    this->cost = this->workingCost;
+    this->drawn++;
+    update();
+    if(this->dirty)
+        requestFrame();
+}
+
+QImage TraceView::rasterise(const frame& f, fa::columns* reduced)
+{
+    QImage out(f.size * f.ratio, QImage::Format_RGB32);
+    out.setDevicePixelRatio(f.ratio);
+    out.fill(Qt::white);
+
+    QPainter painter(&out);
+    QRect plot = area(f.size);
+    QFont font = painter.font();
+
+    //
+    // Title, then a legend entry for every shown series.
+    //
+    QFont bold = font;
+    bold.setBold(true);
+    bold.setPixelSize(18);
+    painter.setFont(bold);
+    painter.setPen(Qt::black);
+    painter.drawText(QRect(0, 4, f.size.width(), 26), Qt::AlignCenter, f.title);
+    painter.setFont(font);
+
+    int shown = f.visible[0] + f.visible[1];
+    int left = f.size.width() / 2 - shown * 55;
+    for(int s = 0; s < 2; s++) {
+        if(!f.visible[s])
+            continue;
+        painter.fillRect(left, 38, 12, 12, seriesColours[s]);
+        painter.setPen(Qt::black);
+        painter.drawText(left + 16, 34, 90, 20, Qt::AlignVCenter, seriesNames[s]);
+        left += 110;
+    }
+
+    //
+    // Grid and tick labels, then the axis titles.
+    //
+    painter.setPen(QPen(QColor(0xd8, 0xd8, 0xd8), 1));
+    std::vector<float> ticksX = fa::ticks(f.x, f.ticks);
+    std::vector<float> ticksY = fa::ticks(f.y, f.ticksY);
+    for(float t : ticksX) {
+        int at = plot.left() + std::lround(f.x.position(t));
+        painter.drawLine(at, plot.top(), at, plot.bottom());
+    }
+    for(float t : ticksY) {
+        int at = plot.bottom() - std::lround(f.y.position(t));
+        painter.drawLine(plot.left(), at, plot.right(), at);
+    }
+
+    painter.setPen(Qt::black);
+    for(float t : ticksX) {
+        int at = plot.left() + std::lround(f.x.position(t));
+        painter.drawText(at - 40, plot.bottom() + 4, 80, 16, Qt::AlignHCenter | Qt::AlignTop, QString::number(t, 'g', 6));
+    }
+    for(float t : ticksY) {
+        int at = plot.bottom() - std::lround(f.y.position(t));
+        painter.drawText(0, at - 8, plot.left() - 6, 16, Qt::AlignRight | Qt::AlignVCenter, QString::number(t, 'g', 4));
+    }
+    painter.drawText(QRect(plot.left(), plot.bottom() + 22, plot.width(), 20), Qt::AlignCenter, QString::fromUtf8(f.titles[0]));
+    painter.save();
+    painter.translate(4, plot.center().y());
+    painter.rotate(-90);
+    painter.drawText(QRect(-plot.height() / 2, 0, plot.height(), 18), Qt::AlignCenter, QString::fromUtf8(f.titles[1]));
+    painter.restore();
+    painter.drawRect(plot);
+
+    //
+    // Each series is two lines per pixel column at most: from where the
+    // previous column ended to where this one starts, and the column's
+    // span. Lines in from off either end are clipped at the frame.
+    //
+    painter.setClipRect(plot);
+    QVector<QLineF> lines;
+    lines.reserve(2 * (plot.width() + 2));
+    const std::vector<float>* values[2] = {&f.data.x, &f.data.y};
+    for(int s = 0; s < 2; s++) {
+        size_t count = std::min(f.data.index.size(), values[s]->size());
+        if(!f.visible[s] || count == 0)
+            continue;
+
+        fa::columns& c = reduced[s];
+        c.reduce(f.data.index.data(), values[s]->data(), count, f.x, f.y);
+
+        auto y = [&](float v) { return plot.bottom() - f.y.position(v); };
+        size_t last = c.used.size() - 1;
+        bool started = false;
+        QPointF previous;
+        lines.clear();
+        for(size_t i = 0; i <= last; i++) {
+            if(!c.used[i])
+                continue;
+            qreal at = plot.left() + (i == 0 ? c.outside[0] : i == last ? c.outside[1] : i - 0.5);
+            if(started)
+                lines.append(QLineF(previous, QPointF(at, y(c.first[i]))));
+            if(c.high[i] > c.low[i])
+                lines.append(QLineF(at, y(c.low[i]), at, y(c.high[i])));
+            previous = QPointF(at, y(c.last[i]));
+            started = true;
+        }
+        painter.setPen(QPen(seriesColours[s], 1));
+        painter.drawLines(lines);
+    }
+
+    return out;
+}
+
+void TraceView::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    QPainter painter(this);
+
+    if(this->image.isNull())
+        painter.fillRect(rect(), Qt::white);
+    else
+        painter.drawImage(0, 0, this->image);
+}
+
+void TraceView::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    requestFrame();
+}
+
+bool TraceView::event(QEvent *event)
+{
+    if (event->type() == QEvent::HoverLeave)
+        m_isMouseOver = false;
+    if (event->type() == QEvent::HoverEnter || event->type() == QEvent::HoverMove)
+        m_isMouseOver = true;
+
+    if (event->type() == QEvent::Gesture) {
+        QGestureEvent* gestures = static_cast<QGestureEvent*>(event);
+        if (QGesture *gesture = gestures->gesture(Qt::PanGesture)) {
+            QPanGesture *pan = static_cast<QPanGesture *>(gesture);
+            scroll(-(pan->delta().x()), pan->delta().y());
+        }
+        if (QGesture *gesture = gestures->gesture(Qt::PinchGesture)) {
+            QPinchGesture *pinch = static_cast<QPinchGesture *>(gesture);
+            if (pinch->changeFlags() & QPinchGesture::ScaleFactorChanged)
+                zoom(pinch->scaleFactor());
+        }
+        return true;
+    }
+
+    return QWidget::event(event);
+}
+
+void TraceView::zoomTo(QRectF pixels)
+{
+    //
+    // `pixels` is relative to the plot area, y pointing down. Log axes
+    // zoom evenly in log space because the scales map that way.
+    //
+    fa::scale x = scaleX();
+    fa::scale y = scaleY();
+    float lowX = x.value(pixels.left());
+    float highX = x.value(pixels.right());
+    float lowY = y.value(y.pixels - pixels.bottom());
+    float highY = y.value(y.pixels - pixels.top());
+    if(!(highX > lowX) || !(highY > lowY))
+        return;
+
+    this->pending.x.low = lowX;
+    this->pending.x.high = highX;
+    this->pending.y.low = lowY;
+    this->pending.y.high = highY;
+    this->pending.ticksY = this->pending.y.log ? 0 : FA_PLOT_TICKS - 1;
+    requestFrame();
+    emit rangeChanged(lowX, highX);
+}
+
+void TraceView::zoom(qreal factor)
+{
+    QRectF plot(QPointF(0, 0), plotArea().size());
+    QSizeF size = plot.size() / factor;
+    zoomTo(QRectF(plot.center() - QPointF(size.width() / 2, size.height() / 2), size));
+}
+
+void TraceView::scroll(qreal dx, qreal dy)
+{
+    zoomTo(QRectF(QPointF(0, 0), plotArea().size()).translated(dx, -dy));
+}
+
+void TraceView::mousePressEvent(QMouseEvent *event)
+{
+    if (m_selectBand && event->button() == Qt::LeftButton) {
+        if (!m_band)
+            m_band = new QRubberBand(QRubberBand::Rectangle, this);
+        m_origin = event->pos();
+        m_band->setGeometry(QRect(m_origin, QSize()));
+        m_band->show();
+        return;
+    }
+
+    if (m_isRunning) {
+        m_isRunning = false;
+        emit frozen();
+    }
+
+    if (event->button() == Qt::LeftButton && plotArea().contains(event->pos())) {
+        if (!m_band)
+            m_band = new QRubberBand(QRubberBand::Rectangle, this);
+        m_origin = event->pos();
+        m_band->setGeometry(QRect(m_origin, QSize()));
+        m_band->show();
+    }
+    else if (event->button() == Qt::RightButton) {
+        zoom(0.5);
+    }
+}
+
+void TraceView::mouseMoveEvent(QMouseEvent *event)
+{
+    QRect plot = plotArea();
+    m_globalPos = event->globalPos();
+    m_pos = event->pos();
+    m_mouseIndex = scaleX().value(event->pos().x() - plot.left());
+    if (m_band && m_band->isVisible()) {
+        if (m_selectBand)
+            m_band->setGeometry(QRect(QPoint(m_origin.x(), plot.top()), QPoint(event->pos().x(), plot.bottom())).normalized());
+        else
+            m_band->setGeometry(QRect(m_origin, event->pos()).normalized() & plot);
+    }
+}
+
+void TraceView::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (!m_band || !m_band->isVisible() || event->button() != Qt::LeftButton)
+        return;
+
+    QRect plot = plotArea();
+    QRect dragged = m_band->geometry();
+    m_band->hide();
+    if (qAbs(event->pos().x() - m_origin.x()) <= 2)
+        return;
+
+    if (m_selectBand) {
+        fa::scale x = scaleX();
+        qreal start = x.value(m_origin.x() - plot.left());
+        qreal stop = x.value(event->pos().x() - plot.left());
+        emit bandSelected(qMin(start, stop), qMax(start, stop));
+    }
+    else if (dragged.height() > 2) {
+        zoomTo(QRectF(dragged.translated(-plot.topLeft())));
+    }
+}
+
+void TraceView::keyPressEvent(QKeyEvent *event)
+{
+    switch (event->key()) {
+    case Qt::Key_Plus:
+        zoom(2);
+        break;
+    case Qt::Key_Minus:
+        zoom(0.5);
+        break;
+    case Qt::Key_Left:
+        scroll(-10, 0);
+        break;
+    case Qt::Key_Right:
+        scroll(10, 0);
+        break;
+    case Qt::Key_Up:
+        scroll(0, 10);
+        break;
+    case Qt::Key_Down:
+        scroll(0, -10);
+        break;
+    default:
+        QWidget::keyPressEvent(event);
+        break;
+    }
+}
+
+double TraceView::frameTime(const fa::trace& trace, QSize size, int frames)
+{
+    fa::trace data = trace;
+    size_t points = data.index.size();
+    QElapsedTimer timer;
+    QImage target;
+
+    TraceView view;
+    view.resize(size);
+    view.setTitle("Benchmark");
+    view.watcher->waitForFinished();
+    timer.start();
+    for(int f = 0; f < frames; f++) {
+        data.x[0] = f * 1e-3f;
+        view.setAxes({0, points * 0.1f}, {-1.2f, 1.2f}, false, false, "Time (ms)", "Positions (um)");
+        view.pending.data = data;
+        view.pending.size = size;
+        view.pending.x.pixels = area(size).width();
+        view.pending.y.pixels = area(size).height();
+        target = rasterise(view.pending, view.reduced);
+    }
+    return timer.nsecsElapsed() / 1e6 / frames;
+}
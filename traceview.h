@@ -0,0 +1,138 @@
+#ifndef TRACEVIEW_H
+#define TRACEVIEW_H
+
+#include <QWidget>
+#include <QImage>
+#include <QRubberBand>
+#include <QFutureWatcher>
+
+#include <tuple>
+
+#include <fa_analysis.h>
+
+#define TRACE_TITLE_LENGTH  96
+#include <fa_plot.h>
+
+//
+// X / Y plot drawn straight from an fa::trace. Each frame reduces both
+// series to min/max pixel columns and rasterises them, with the axes and
+// legend, into a QImage on a worker thread; the widget only blits the last
+// finished image. Frames asked for while one is being drawn collapse into
+// one, drawn from the newest trace.
+//
+// A left drag zooms into the dragged rectangle, a right click zooms out,
+// +/- and the arrow keys zoom and scroll, and touch pinches and pans do
+// the same. Any press stops the live updates.
+//
+class TraceView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit TraceView(QWidget *parent = nullptr);
+    ~TraceView();
+
+    void setTitle(const QString& title);
+    QString title() const;
+
+    // Series 0 is X, series 1 is Y.
+    void setSeriesVisible(int series, bool visible);
+
+    void setTickCount(int ticks);
+
+    //
+    // Ranges, log or linear scales and UTF-8 titles for the traces that
+    // follow, replacing any zoom. A linear y range is widened to round
+    // ticks. The titles are copied into the frame, so a tick does not
+    // allocate for them.
+    //
+    void setAxes(std::tuple<float, float> rangeX, std::tuple<float, float> rangeY, bool logX, bool logY,
+                 const char* titleX, const char* titleY);
+
+    // The trace is copied, the caller keeps reusing its own.
+    void setTrace(const fa::trace& trace);
+    void clear();
+
+    // While enabled a left-button drag selects an x range instead of
+    // zooming, and does not freeze the display.
+    void setBandSelection(bool enabled);
+
+    QRect plotArea() const;
+
+    // Frames drawn so far, and how long the last one took on its worker (ms).
+    int frames() const { return this->drawn; }
+    double frameCost() const { return this->cost; }
+
+    //
+    // Time per frame (ms) of copying `trace` into a frame and rasterising
+    // it at `size`, over `frames` frames on the calling thread rather than
+    // the worker. benchmark/ compares it against QtCharts.
+    //
+    static double frameTime(const fa::trace& trace, QSize size, int frames);
+
+    bool m_isRunning;
+    bool m_isMouseOver;
+    QPoint m_globalPos;
+    QPoint m_pos;
+    qreal m_mouseIndex;
+
+signals:
+    void bandSelected(qreal low, qreal high);
+
+    // A press stopped the live updates.
+    void frozen();
+
+    // The user zoomed or scrolled the x axis.
+    void rangeChanged(qreal min, qreal max);
+
+protected:
+    bool event(QEvent *event);
+    void paintEvent(QPaintEvent *event);
+    void resizeEvent(QResizeEvent *event);
+    void mousePressEvent(QMouseEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
+    void mouseReleaseEvent(QMouseEvent *event);
+    void keyPressEvent(QKeyEvent *event);
+
+private:
+    struct frame
+    {
+        QSize size;
+        qreal ratio;
+        QString title;
+        char titles[2][TRACE_TITLE_LENGTH];
+        fa::scale x;
+        fa::scale y;
+        int ticks;
+        int ticksY;
+        bool visible[2];
+        fa::trace data;
+    };
+
+    static QRect area(QSize size);
+    static QImage rasterise(const frame& f, fa::columns* reduced);
+
+    fa::scale scaleX() const;
+    fa::scale scaleY() const;
+    void zoomTo(QRectF pixels);
+    void zoom(qreal factor);
+    void scroll(qreal dx, qreal dy);
+    void requestFrame();
+    void onFrameReady();
+
+    frame pending;
+    frame working;
+    fa::columns reduced[2];
+    QFutureWatcher<QImage>* watcher;
+    bool dirty;
+    QImage image;
+    int drawn;
+    double cost;
+    double workingCost;
+
+    bool m_selectBand;
+    QRubberBand* m_band;
+    QPoint m_origin;
+};
+
+#endif // TRACEVIEW_H
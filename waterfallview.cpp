@@ -0,0 +1,70 @@
+#include "waterfallview.h"
+
+#include <QPainter>
+#include <QPaintEvent>
+
+WaterfallView::WaterfallView(size_t depth, QWidget *parent) :
+    QWidget(parent),
+    depth(depth)
+{
+    // Every pixel is painted, so scroll() can move the old rows in place.
+    setAttribute(Qt::WA_OpaquePaintEvent, true);
+    setMinimumHeight(100);
+}
+
+void WaterfallView::setRange(float low, float high)
+{
+    this->history.set_range(low, high);
+}
+
+void WaterfallView::clear()
+{
+    this->history.clear();
+    update();
+}
+
+int WaterfallView::rowHeight() const
+{
+    return qMax(1, height() / int(qMax<size_t>(1, this->depth)));
+}
+
+void WaterfallView::append(const std::vector<float>& values)
+{
+    if(values.empty())
+        return;
+
+    // A new bin count starts a new history.
+    if(values.size() != this->history.width()) {
+        this->history.resize(values.size(), this->depth);
+        this->history.push(values.data());
+        update();
+        return;
+    }
+
+    this->history.push(values.data());
+    if(isVisible())
+        scroll(0, rowHeight());
+}
+
+void WaterfallView::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    int h = rowHeight();
+    int first = qMax(0, event->rect().top() / h);
+    int last = event->rect().bottom() / h;
+
+    //
+    // Only the rows the exposed region crosses are drawn, each scaled from
+    // its line of pixels straight out of the ring.
+    //
+    for(int age = first; age <= last; age++) {
+        QRect strip(0, age * h, width(), h);
+        if(size_t(age) < this->history.rows()) {
+            QImage line(reinterpret_cast<const uchar*>(this->history.row(age)), this->history.width(), 1, QImage::Format_RGB32);
+            painter.drawImage(strip, line);
+        }
+        else {
+            painter.fillRect(strip, Qt::black);
+        }
+    }
+}
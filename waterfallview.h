@@ -0,0 +1,37 @@
+#ifndef WATERFALLVIEW_H
+#define WATERFALLVIEW_H
+
+#include <QWidget>
+
+#include <vector>
+
+#include <fa_waterfall.h>
+
+//
+// Spectrogram of the log-f spectrum, newest row at the top. Appending a
+// spectrum scrolls what is already on screen down by one row height and
+// repaints the exposed strip only, so a tick costs one mapped row and one
+// small blit whatever the history depth.
+//
+class WaterfallView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit WaterfallView(size_t depth, QWidget *parent = nullptr);
+
+    void setRange(float low, float high);
+    void append(const std::vector<float>& values);
+    void clear();
+
+protected:
+    void paintEvent(QPaintEvent *event);
+
+private:
+    int rowHeight() const;
+
+    fa::waterfall history;
+    size_t depth;
+};
+
+#endif // WATERFALLVIEW_H